@@ -17,6 +17,29 @@
 /** alphabet */
 static const char base64[]="ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/=";
 
+/**
+ * Decoding table for dec(): 6 bit value for <tt>[A-Za-z0-9+/]</tt>,
+ * -2 for \\0 and =, -1 for everything else.
+ */
+static const signed char Dec[256] = {
+  -2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+  52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -2, -1, -1,
+  -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+  15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+  -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+  41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
 /**
  * convert character to decimal.
  * @param x Character.
@@ -26,23 +49,39 @@ static const char base64[]="ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz
  *   - -1 otherwise
  */
 static inline int dec(unsigned char x) {
-  if (x>='A' && x<='Z') return x-'A';
-  if (x>='a' && x<='z') return x-'a'+26;
-  if (x>='0' && x<='9') return x-'0'+26+26;
-  switch (x) {
-  case '+': return 62;
-  case '/': return 63;
-  case '\0':
-  case '=': return -2;
-  default: return -1;
-  }
+  return Dec[x];
 }
 
 int buffer_base64_decode(buffer_t * dest,const buffer_t * src, size_t* chars) {
   unsigned short tmp=0,bits=0,rc=1;
   register const unsigned char* s=(const unsigned char*) src->str;
+  register unsigned char* d;
+  size_t quads;
   if (chars)
     *chars = 0;
+  if (!s)
+    return rc;
+
+  /*
+   * Make room for all output at once instead of growing per character
+   * and decode complete quadruples straight into it. Anything special
+   * (padding, \\0, invalid input) ends this and is left to the bitwise
+   * decoder below which starts at a quadruple boundary with no bits
+   * pending.
+   */
+  buffer_grow(dest,dest->len+(src->len/4)*3+3);
+  d=(unsigned char*) dest->str+dest->len;
+  for (quads=src->len/4; quads; --quads, s+=4) {
+    int a=Dec[s[0]], b=Dec[s[1]], c=Dec[s[2]], e=Dec[s[3]];
+    if ((a|b|c|e)<0)
+      break;
+    *d++=(a<<2)|(b>>4);
+    *d++=(b<<4)|(c>>2);
+    *d++=(c<<6)|e;
+  }
+  dest->len=(char*) d-dest->str;
+  dest->str[dest->len]='\0';
+
   for (;;) {
     int a=dec(*s);
     switch(a) {
@@ -87,6 +87,8 @@ int buffer_qp_decode(buffer_t* dst, const buffer_t* src, unsigned char c, size_t
     return 0;
 
   buffer_shrink(dst,0);
+  /* output never is longer than input */
+  buffer_grow(dst,src->len);
 
   for (i = 0; i < (int)src->len; i++) {
     if ((unsigned char)src->str[i] == c) {
@@ -108,8 +110,13 @@ int buffer_qp_decode(buffer_t* dst, const buffer_t* src, unsigned char c, size_t
         return (0);
       }
     }
-    else
-      buffer_add_ch(dst,(unsigned char)src->str[i]);
+    else {
+      /* copy everything up to the next magic character in one go */
+      const char* p = memchr(src->str+i,c,src->len-i);
+      int run = (p ? p-src->str : (int) src->len)-i;
+      buffer_add_str(dst,src->str+i,run);
+      i += run-1;
+    }
   }
   if (chars)
     *chars = 0;
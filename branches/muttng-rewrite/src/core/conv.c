@@ -28,6 +28,30 @@
 /** Hash table of known character sets for faster access */
 static void* Charsets = NULL;
 
+/** How many conversion descriptors to keep open for reuse */
+#define ICONV_CACHE_LEN 8
+
+/**
+ * Conversion descriptors kept open for reuse.
+ * @c iconv_open() is expensive compared to converting the short
+ * strings we usually see (header words, parameters).
+ */
+static struct {
+  /** normalized target character set, @c NULL if slot unused */
+  char* tocode;
+  /** normalized source character set */
+  char* fromcode;
+  /** descriptor */
+  iconv_t cd;
+  /** stamp of last use for LRU replacement */
+  unsigned long used;
+  /** whether currently handed out */
+  int busy;
+} IconvCache[ICONV_CACHE_LEN];
+
+/** Counter for IconvCache::used */
+static unsigned long IconvUsed = 0;
+
 /**
  * Map strange charset names to MIME ones.
  * The following list has been created manually from the data under:
@@ -311,6 +335,14 @@ void conv_init () {
 }
 
 void conv_cleanup () {
+  int i;
+  for (i = 0; i < ICONV_CACHE_LEN; i++) {
+    if (!IconvCache[i].tocode)
+      continue;
+    iconv_close(IconvCache[i].cd);
+    mem_free(&IconvCache[i].tocode);
+    mem_free(&IconvCache[i].fromcode);
+  }
   hash_destroy(&Charsets,NULL);
 }
 
@@ -400,16 +432,54 @@ unsigned long conv_charset_list (int mime, int (*printfunc)(const char*)) {
   return rc;
 }
 
+/**
+ * Remember descriptor for reuse, replacing the least recently used one.
+ * If all slots are busy, the descriptor simply isn't cached.
+ * @param tocode Normalized target character set.
+ * @param fromcode Normalized source character set.
+ * @param cd Descriptor just handed out by my_iconv_open().
+ */
+static void iconv_cache_add (const char* tocode, const char* fromcode,
+                             iconv_t cd) {
+  int i, slot = -1;
+
+  for (i = 0; i < ICONV_CACHE_LEN; i++) {
+    if (IconvCache[i].busy)
+      continue;
+    if (!IconvCache[i].tocode) {
+      slot = i;
+      break;
+    }
+    if (slot < 0 || IconvCache[i].used < IconvCache[slot].used)
+      slot = i;
+  }
+  if (slot < 0)
+    return;
+
+  if (IconvCache[slot].tocode) {
+    iconv_close(IconvCache[slot].cd);
+    mem_free(&IconvCache[slot].tocode);
+    mem_free(&IconvCache[slot].fromcode);
+  }
+  IconvCache[slot].tocode = str_dup(tocode);
+  IconvCache[slot].fromcode = str_dup(fromcode);
+  IconvCache[slot].cd = cd;
+  IconvCache[slot].used = ++IconvUsed;
+  IconvCache[slot].busy = 1;
+}
+
 /**
  * Like original @c iconv_open() but canoninitialized character sets
- * first.
+ * first. Descriptors are taken from and added to the cache and must
+ * be given back via my_iconv_close().
  * @param tocode To which charset to convert.
  * @param fromcode From which charset to convert.
  * @return Conversion description from @c iconv_open().
  */
 static iconv_t my_iconv_open (const char *tocode, const char *fromcode) {
   buffer_t tocode1, fromcode1;
-  iconv_t cd;
+  iconv_t cd = (iconv_t) -1;
+  int i;
 
   buffer_init(&tocode1);
   buffer_add_str(&tocode1,tocode,-1);
@@ -420,7 +490,19 @@ static iconv_t my_iconv_open (const char *tocode, const char *fromcode) {
   conv_charset_normal(&tocode1);
   conv_charset_normal(&fromcode1);
 
-  cd = iconv_open(tocode1.str,fromcode1.str);
+  for (i = 0; i < ICONV_CACHE_LEN; i++)
+    if (!IconvCache[i].busy && IconvCache[i].tocode &&
+        str_cmp(IconvCache[i].tocode,tocode1.str) == 0 &&
+        str_cmp(IconvCache[i].fromcode,fromcode1.str) == 0) {
+      IconvCache[i].busy = 1;
+      IconvCache[i].used = ++IconvUsed;
+      cd = IconvCache[i].cd;
+      break;
+    }
+
+  if (cd == (iconv_t) -1 &&
+      (cd = iconv_open(tocode1.str,fromcode1.str)) != (iconv_t) -1)
+    iconv_cache_add(tocode1.str,fromcode1.str,cd);
 
   buffer_free(&tocode1);
   buffer_free(&fromcode1);
@@ -428,6 +510,22 @@ static iconv_t my_iconv_open (const char *tocode, const char *fromcode) {
   return (cd);
 }
 
+/**
+ * Give back descriptor obtained via my_iconv_open(). Cached
+ * descriptors are reset to initial state, others are closed.
+ * @param cd Conversion description.
+ */
+static void my_iconv_close (iconv_t cd) {
+  int i;
+  for (i = 0; i < ICONV_CACHE_LEN; i++)
+    if (IconvCache[i].busy && IconvCache[i].cd == cd) {
+      iconv(cd,0,0,0,0);
+      IconvCache[i].busy = 0;
+      return;
+    }
+  iconv_close(cd);
+}
+
 /**
  * Like iconv, but keeps going even when the input is invalid
  * If you're supplying inrepls, the source charset should be stateless;
@@ -568,7 +666,7 @@ int conv_iconv (buffer_t* src, const char* from, const char* to) {
     ob = buf = mem_malloc (obl + 1);
 
     my_iconv (cd, &ib, &ibl, &ob, &obl, inrepls, outrepl, &err);
-    iconv_close (cd);
+    my_iconv_close (cd);
 
     *ob = '\0';
 
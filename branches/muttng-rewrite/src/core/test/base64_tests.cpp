@@ -27,6 +27,8 @@ base64_tests::base64_tests() : suite("base64_tests") {
   add("base64",testcase(this,"test_encode",&base64_tests::test_encode));
   add("base64",testcase(this,"test_decode",&base64_tests::test_decode));
   add("base64",testcase(this,"test_both",&base64_tests::test_both));
+  add("base64",testcase(this,"test_invalid",&base64_tests::test_invalid));
+  add("base64",testcase(this,"test_large",&base64_tests::test_large));
 }
 
 base64_tests::~base64_tests() { }
@@ -103,3 +105,66 @@ void base64_tests::test_both() {
     assert_true(msg.str,buffer_equal2(&tmp2,&dec));
   }
 }
+
+/** table with invalid input */
+static struct {
+  /** encoded string */
+  const char * encoded;
+  /** what should be decoded before error */
+  const char * decoded;
+  /** position of first invalid character */
+  size_t pos;
+} InvalidTable[] = {
+  { "!XNkZg==", "", 0 },
+  { "YX!kZg==", "a", 2 },
+  { "YXNk!Zg==", "asd", 4 },
+  { "YXNkYXNkYXNkYXNk\nYXNk", "asdasdasdasd", 16 },
+  { NULL, NULL, 0 } // end of table
+};
+
+void base64_tests::test_invalid() {
+  int i;
+  size_t pos;
+  buffer_t enc, tmp, msg;
+  buffer_init(&enc); buffer_init(&tmp); buffer_init(&msg);
+
+  for (i=0;InvalidTable[i].encoded;++i) {
+    buffer_shrink(&enc,0); buffer_shrink(&tmp,0); buffer_shrink(&msg,0);
+    buffer_add_str(&enc,InvalidTable[i].encoded,-1);
+
+    assert_true("decode fails",!buffer_base64_decode(&tmp,&enc,&pos));
+
+    buffer_add_str(&msg,"'",-1);
+    buffer_add_buffer(&msg,&enc);
+    buffer_add_str(&msg,"' fails at position ",-1);
+    buffer_add_snum(&msg,InvalidTable[i].pos,-1);
+    assert_eq(msg.str,InvalidTable[i].pos,pos);
+    assert_true(msg.str,buffer_equal1(&tmp,InvalidTable[i].decoded,-1));
+  }
+  buffer_free(&enc); buffer_free(&tmp); buffer_free(&msg);
+}
+
+void base64_tests::test_large() {
+  int i, l;
+  buffer_t dec, enc, tmp;
+  buffer_init(&dec); buffer_init(&enc); buffer_init(&tmp);
+
+  /* some binary data including \\0 of all lengths modulo 3 */
+  for (l = 1024*1024; l < 1024*1024+3; l++) {
+    buffer_shrink(&dec,0); buffer_shrink(&enc,0); buffer_shrink(&tmp,0);
+    buffer_grow(&dec,l); buffer_grow(&enc,(l+2)/3*4);
+    for (i = 0; i < l; i++)
+      buffer_add_ch(&dec,(unsigned char)(((unsigned)i*7919)>>3));
+
+    buffer_base64_encode(&enc,&dec);
+    assert_eq("encoded length",(size_t)((l+2)/3*4),enc.len);
+
+    /* decoding must append to what's there */
+    buffer_add_str(&tmp,"prefix",6);
+    assert_true("decode works",buffer_base64_decode(&tmp,&enc,NULL));
+    assert_eq("decoded length",(size_t)(l+6),tmp.len);
+    assert_true("prefix kept",strncmp(tmp.str,"prefix",6)==0);
+    assert_true("data decoded correctly",memcmp(tmp.str+6,dec.str,l)==0);
+  }
+  buffer_free(&dec); buffer_free(&enc); buffer_free(&tmp);
+}
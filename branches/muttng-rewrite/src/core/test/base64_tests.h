@@ -31,6 +31,16 @@ class base64_tests : public suite {
      * @test buffer_encode_base64().
      */
     void test_both();
+    /**
+     * @test buffer_decode_base64() reports the position of
+     * invalid input wherever it is.
+     */
+    void test_invalid();
+    /**
+     * @test buffer_decode_base64().
+     * @test buffer_encode_base64().
+     */
+    void test_large();
 };
 
 #endif
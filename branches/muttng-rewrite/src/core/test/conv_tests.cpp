@@ -108,9 +108,58 @@ void conv_tests::test_iconv() {
   buffer_free(&conv2);
 }
 
+void conv_tests::test_iconv_reuse() {
+  buffer_t first, conv, msg;
+  int i = 0, a = 0;
+
+  buffer_init(&first);
+  buffer_init(&conv);
+  buffer_init(&msg);
+
+  /**
+   * Convert the same strings over and over while cycling through
+   * more character sets than descriptors are cached: results must
+   * not depend on whether a descriptor was reused or not, and state
+   * of stateful encodings mustn't leak into the next conversion.
+   */
+  for (i = 0; i < 20; i++) {
+    for (a = 0; ToSets[a]; a++) {
+      buffer_shrink(&conv,0);
+      buffer_add_str(&conv,TestStrings[2].str,-1);
+      conv_iconv(&conv,"utf-8",ToSets[a]);
+      conv_iconv(&conv,ToSets[a],"utf-8");
+      if (i == 0 && a == 1) {
+        buffer_shrink(&first,0);
+        buffer_add_buffer(&first,&conv);
+      } else if (a == 1) {
+        buffer_shrink(&msg,0);
+        buffer_add_str(&msg,"round trip #",-1);
+        buffer_add_snum(&msg,i,-1);
+        buffer_add_str(&msg," via ",-1);
+        buffer_add_str(&msg,ToSets[a],-1);
+        buffer_add_str(&msg," is stable",-1);
+        assert_true(msg.str,buffer_equal2(&first,&conv));
+      }
+    }
+    buffer_shrink(&conv,0);
+    buffer_add_str(&conv,"\346\227\245\346\234\254",-1);
+    assert_true("utf-8 -> iso-2022-jp works",
+                conv_iconv(&conv,"utf-8","iso-2022-jp"));
+    buffer_shrink(&conv,0);
+    buffer_add_str(&conv,TestStrings[0].str,-1);
+    conv_iconv(&conv,"utf-8","iso-2022-jp");
+    assert_true("no shift state left over",
+                str_eq(conv.str,TestStrings[0].str));
+  }
+  buffer_free(&first);
+  buffer_free(&conv);
+  buffer_free(&msg);
+}
+
 conv_tests::conv_tests() : suite("conv_tests") {
   core_init();
   add("iconv",testcase(this,"test_iconv",&conv_tests::test_iconv));
+  add("iconv",testcase(this,"test_iconv_reuse",&conv_tests::test_iconv_reuse));
 }
 
 conv_tests::~conv_tests() {
@@ -22,6 +22,11 @@ class conv_tests : public suite {
    * @test conv_iconv().
    */
   void test_iconv();
+  /**
+   * Test for conv_iconv() reusing cached descriptors.
+   * @test conv_iconv().
+   */
+  void test_iconv_reuse();
   public:
     conv_tests();
     ~conv_tests();
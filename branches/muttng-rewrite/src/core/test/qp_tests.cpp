@@ -37,6 +37,7 @@ qp_tests::qp_tests() : suite("qp_tests") {
   add("qp",testcase(this,"test_encode",&qp_tests::test_encode));
   add("qp",testcase(this,"test_decode",&qp_tests::test_decode));
   add("qp",testcase(this,"test_both",&qp_tests::test_both));
+  add("qp",testcase(this,"test_large",&qp_tests::test_large));
 }
 
 qp_tests::~qp_tests() { }
@@ -125,3 +126,27 @@ void qp_tests::test_both() {
     assert_true(msg.str,buffer_equal2(&tmp2,&dec));
   }
 }
+
+void qp_tests::test_large() {
+  int i;
+  size_t l;
+  buffer_t dec, enc, tmp;
+  buffer_init(&dec); buffer_init(&enc); buffer_init(&tmp);
+
+  /* long runs of plain text with some special characters in between */
+  buffer_grow(&dec,1024*1024); buffer_grow(&enc,1024*1024*3);
+  for (i = 0; i < 1024*1024; i++)
+    buffer_add_ch(&dec,(i%97)==0 ? '=' : (i%89)==0 ? 0xe4 : 'a'+(i%26));
+
+  buffer_qp_encode(&enc,&dec,'=');
+  assert_true("decode works",buffer_qp_decode(&tmp,&enc,'=',&l));
+  assert_eq("no error position",(size_t)0,l);
+  assert_true("data decoded correctly",buffer_equal2(&tmp,&dec));
+
+  /* errors are still found after long runs */
+  buffer_add_str(&enc,"=0",2);
+  assert_true("decode fails",!buffer_qp_decode(&tmp,&enc,'=',&l));
+  assert_eq("error position",enc.len-2,l);
+
+  buffer_free(&dec); buffer_free(&enc); buffer_free(&tmp);
+}
@@ -30,6 +30,11 @@ class qp_tests : public suite {
      * @test buffer_decode_qp().
      */
     void test_both();
+    /**
+     * @test buffer_encode_qp().
+     * @test buffer_decode_qp().
+     */
+    void test_large();
 };
 
 #endif
@@ -40,14 +40,164 @@ static struct mapping_t AliasHelp[] = {
   {NULL}
 };
 
+/*
+ * Aliases are indexed by lowercase name and by lowercase mailbox of
+ * each of their addresses; both hashes hold alias_key_t nodes which
+ * own the key. Aliases must be indexed while they are in the list
+ * and unindexed before they are taken out or their addresses change.
+ * For completion a copy of the list sorted by name is built when it
+ * is needed after the aliases changed.
+ */
+
+typedef struct alias_key {
+  char *key;
+  ALIAS *alias;
+  ADDRESS *addr;                /* NULL for names */
+} alias_key_t;
+
+static HASH *AliasNames = NULL;
+static HASH *AliasMailboxes = NULL;
+static ALIAS *AliasTail = NULL;
+static unsigned long AliasSeq = 0;
+static ALIAS **AliasSorted = NULL;
+static int AliasSortedCount = 0;
+static int AliasSortedValid = 0;
+
+static char *alias_key (const char *s)
+{
+  char *key = str_dup (s), *p;
+
+  for (p = key; p && *p; p++)
+    *p = ascii_tolower (*p);
+  return key;
+}
+
+static HASH *alias_hash_insert (HASH * table, alias_key_t * k)
+{
+  if (!table)
+    table = hash_create (1031);
+  else if (table->curnelem > 2 * table->nelem)
+    table = hash_resize (table, 4 * table->nelem + 1);
+  hash_insert (table, k->key, k, 1);
+  return table;
+}
+
+/* finds the node for alias and addr under key */
+static alias_key_t *alias_hash_find (HASH * table, const char *key,
+                                     ALIAS * alias, ADDRESS * addr)
+{
+  struct hash_elem *elem;
+
+  if (!table)
+    return NULL;
+  elem = table->table[hash_string ((unsigned char *) key, table->nelem)];
+  for (; elem; elem = elem->next) {
+    alias_key_t *k = (alias_key_t *) elem->data;
+
+    if (k->alias == alias && k->addr == addr && !str_cmp (k->key, key))
+      return k;
+  }
+  return NULL;
+}
+
+static void alias_hash_delete (HASH * table, const char *s, ALIAS * alias,
+                               ADDRESS * addr)
+{
+  alias_key_t *k;
+  char *key = alias_key (s);
+
+  if ((k = alias_hash_find (table, key, alias, addr))) {
+    hash_delete (table, key, k, NULL);
+    mem_free (&k->key);
+    mem_free (&k);
+  }
+  mem_free (&key);
+}
+
+void mutt_alias_index (ALIAS * t)
+{
+  alias_key_t *k;
+  ADDRESS *ap;
+
+  if (t->name) {
+    k = mem_calloc (1, sizeof (alias_key_t));
+    k->key = alias_key (t->name);
+    k->alias = t;
+    AliasNames = alias_hash_insert (AliasNames, k);
+  }
+
+  for (ap = t->addr; ap; ap = ap->next) {
+    if (ap->group || !ap->mailbox)
+      continue;
+    k = mem_calloc (1, sizeof (alias_key_t));
+    k->key = alias_key (ap->mailbox);
+    k->alias = t;
+    k->addr = ap;
+    AliasMailboxes = alias_hash_insert (AliasMailboxes, k);
+  }
+
+  AliasSortedValid = 0;
+}
+
+void mutt_alias_unindex (ALIAS * t)
+{
+  ADDRESS *ap;
+
+  if (t->name)
+    alias_hash_delete (AliasNames, t->name, t, NULL);
+  for (ap = t->addr; ap; ap = ap->next)
+    if (!ap->group && ap->mailbox)
+      alias_hash_delete (AliasMailboxes, ap->mailbox, t, ap);
+
+  if (t == AliasTail)
+    AliasTail = NULL;
+  AliasSortedValid = 0;
+}
+
+/* adds a new alias to the end of the list and indexes it */
+void mutt_alias_append (ALIAS * t)
+{
+  if (!Aliases)
+    Aliases = t;
+  else {
+    if (!AliasTail)
+      for (AliasTail = Aliases; AliasTail->next;
+           AliasTail = AliasTail->next);
+    AliasTail->next = t;
+  }
+  AliasTail = t;
+  t->seq = ++AliasSeq;
+  mutt_alias_index (t);
+}
+
+ALIAS *mutt_alias_find (const char *s)
+{
+  struct hash_elem *elem;
+  char *key;
+  ALIAS *t = NULL;
+
+  if (!AliasNames || !s)
+    return NULL;
+
+  key = alias_key (s);
+  elem = AliasNames->table[hash_string ((unsigned char *) key,
+                                        AliasNames->nelem)];
+  for (; elem; elem = elem->next) {
+    alias_key_t *k = (alias_key_t *) elem->data;
+
+    /* names are unique, but check for stale entries anyway */
+    if (!str_cmp (k->key, key) && (!t || k->alias->seq < t->seq))
+      t = k->alias;
+  }
+  mem_free (&key);
+  return t;
+}
+
 ADDRESS *mutt_lookup_alias (const char *s)
 {
-  ALIAS *t = Aliases;
+  ALIAS *t = mutt_alias_find (s);
 
-  for (; t; t = t->next)
-    if (!str_casecmp (s, t->name))
-      return (t->addr);
-  return (NULL);                /* no such alias */
+  return (t ? t->addr : NULL);  /* no such alias */
 }
 
 static ADDRESS *mutt_expand_aliases_r (ADDRESS * a, LIST ** expn)
@@ -206,7 +356,7 @@ ADDRESS *mutt_get_address (ENVELOPE * env, char **pfxp)
 
 void mutt_create_alias (ENVELOPE * cur, ADDRESS * iadr)
 {
-  ALIAS *new, *t;
+  ALIAS *new;
   char buf[LONG_STRING], prompt[SHORT_STRING], *pc;
   char *err = NULL;
   char fixed[LONG_STRING];
@@ -302,13 +452,7 @@ retry_name:
     return;
   }
 
-  if ((t = Aliases)) {
-    while (t->next)
-      t = t->next;
-    t->next = new;
-  }
-  else
-    Aliases = new;
+  mutt_alias_append (new);
 
   strfcpy (buf, NONULL (AliasFile), sizeof (buf));
   if (mutt_get_field (_("Save to file: "), buf, sizeof (buf), M_FILE) != 0)
@@ -363,27 +507,74 @@ int mutt_check_alias_name (const char *s, char *d)
   return rv;
 }
 
+/* whether x comes before y in alias t */
+static int alias_addr_before (ALIAS * t, ADDRESS * x, ADDRESS * y)
+{
+  ADDRESS *ap;
+
+  for (ap = t->addr; ap; ap = ap->next) {
+    if (ap == x)
+      return 1;
+    if (ap == y)
+      return 0;
+  }
+  return 0;
+}
+
 /*
  * This routine looks to see if the user has an alias defined for the given
  * address.
  */
 ADDRESS *alias_reverse_lookup (ADDRESS * a)
 {
-  ALIAS *t = Aliases;
-  ADDRESS *ap;
+  struct hash_elem *elem;
+  alias_key_t *k, *best = NULL;
+  char *key;
 
-  if (!a || !a->mailbox)
+  if (!a || !a->mailbox || !AliasMailboxes)
     return NULL;
 
-  for (; t; t = t->next) {
-    /* cycle through all addresses if this is a group alias */
-    for (ap = t->addr; ap; ap = ap->next) {
-      if (!ap->group && ap->mailbox &&
-          ascii_strcasecmp (ap->mailbox, a->mailbox) == 0)
-        return ap;
-    }
-  }
-  return 0;
+  /* the first alias in the list wins, like when walking it */
+  key = alias_key (a->mailbox);
+  elem = AliasMailboxes->table[hash_string ((unsigned char *) key,
+                                            AliasMailboxes->nelem)];
+  for (; elem; elem = elem->next) {
+    k = (alias_key_t *) elem->data;
+    if (!str_cmp (k->key, key) && (!best || k->alias->seq < best->alias->seq
+                                   || (k->alias == best->alias
+                                       && alias_addr_before (k->alias,
+                                                             k->addr,
+                                                             best->addr))))
+      best = k;
+  }
+  mem_free (&key);
+  return best ? best->addr : NULL;
+}
+
+static int alias_sort_name (const void *a, const void *b)
+{
+  return str_cmp ((*((ALIAS **) a))->name, (*((ALIAS **) b))->name);
+}
+
+/* (re)builds the list of aliases sorted by name */
+static void alias_sort (void)
+{
+  ALIAS *t;
+  int count = 0;
+
+  if (AliasSortedValid)
+    return;
+
+  for (t = Aliases; t; t = t->next)
+    count++;
+  mem_realloc (&AliasSorted, (count ? count : 1) * sizeof (ALIAS *));
+
+  AliasSortedCount = 0;
+  for (t = Aliases; t; t = t->next)
+    if (t->name)
+      AliasSorted[AliasSortedCount++] = t;
+  qsort (AliasSorted, AliasSortedCount, sizeof (ALIAS *), alias_sort_name);
+  AliasSortedValid = 1;
 }
 
 /* alias_complete() -- alias completion routine
@@ -397,24 +588,35 @@ int mutt_alias_complete (char *s, size_t buflen)
   ALIAS *a = Aliases;
   ALIAS *a_list = NULL, *a_cur = NULL;
   char bestname[HUGE_STRING];
-  int i;
+  size_t len;
+  int i, lo, hi;
 
 #define min(a,b)        ((a<b)?a:b)
 
   if (s[0] != 0) {              /* avoid empty string as strstr argument */
     memset (bestname, 0, sizeof (bestname));
-
-    while (a) {
-      if (a->name && strstr (a->name, s) == a->name) {
-        if (!bestname[0])       /* init */
-          strfcpy (bestname, a->name,
-                   min (str_len (a->name) + 1, sizeof (bestname)));
-        else {
-          for (i = 0; a->name[i] && a->name[i] == bestname[i]; i++);
-          bestname[i] = 0;
-        }
-      }
-      a = a->next;
+    len = str_len (s);
+
+    /* the matches are a range of the sorted names; their common
+     * prefix is that of the first and the last one */
+    alias_sort ();
+    for (lo = 0, hi = AliasSortedCount; lo < hi;) {
+      i = (lo + hi) / 2;
+      if (str_cmp (AliasSorted[i]->name, s) < 0)
+        lo = i + 1;
+      else
+        hi = i;
+    }
+    for (hi = lo; hi < AliasSortedCount &&
+         !str_ncmp (AliasSorted[hi]->name, s, len); hi++);
+
+    if (hi > lo) {
+      a = AliasSorted[lo];
+      strfcpy (bestname, a->name,
+               min (str_len (a->name) + 1, sizeof (bestname)));
+      a = AliasSorted[hi - 1];
+      for (i = 0; a->name[i] && a->name[i] == bestname[i]; i++);
+      bestname[i] = 0;
     }
 
     if (bestname[0] != 0) {
@@ -428,7 +630,7 @@ int mutt_alias_complete (char *s, size_t buflen)
 
       a = Aliases;
       while (a) {
-        if (a->name && (strstr (a->name, s) == a->name)) {
+        if (a->name && !str_ncmp (a->name, s, len)) {
           if (!a_list)          /* init */
             a_cur = a_list = (ALIAS *) mem_malloc (sizeof (ALIAS));
           else {
@@ -465,6 +667,7 @@ int mutt_alias_complete (char *s, size_t buflen)
         Aliases = a_cur->next;
 
       a_cur->next = NULL;
+      mutt_alias_unindex (a_cur);
       mutt_free_alias (&a_cur);
 
       if (a_list)
@@ -718,14 +921,18 @@ new_aliases:
 
   for (i = 0; i < menu->max; i++) {
     if (AliasTable[i]->tagged) {
+      mutt_alias_unindex (AliasTable[i]->self);
       mutt_addrlist_to_local (AliasTable[i]->addr);
+      mutt_alias_index (AliasTable[i]->self);
       rfc822_write_address (buf, buflen, AliasTable[i]->addr, 0);
       t = -1;
     }
   }
 
   if (t != -1) {
+    mutt_alias_unindex (AliasTable[t]->self);
     mutt_addrlist_to_local (AliasTable[t]->addr);
+    mutt_alias_index (AliasTable[t]->self);
     rfc822_write_address (buf, buflen, AliasTable[t]->addr, 0);
   }
 
@@ -19,6 +19,7 @@ typedef struct alias {
   short tagged;
   short del;
   short num;
+  unsigned long seq;            /* position in Aliases, for the index */
 } ALIAS;
 
 void mutt_create_alias (ENVELOPE *, ADDRESS *);
@@ -28,6 +29,10 @@ ADDRESS *mutt_lookup_alias (const char *s);
 ADDRESS *mutt_expand_aliases (ADDRESS *);
 void mutt_expand_aliases_env (ENVELOPE *);
 void mutt_free_alias (ALIAS **);
+ALIAS *mutt_alias_find (const char *);
+void mutt_alias_append (ALIAS *);
+void mutt_alias_index (ALIAS *);
+void mutt_alias_unindex (ALIAS *);
 ADDRESS *alias_reverse_lookup (ADDRESS *);
 int mutt_alias_complete (char *, size_t);
 int mutt_addr_is_user (ADDRESS *);
@@ -274,6 +274,69 @@ int iconv_close (iconv_t cd)
 #endif /* !HAVE_ICONV */
 
 
+/*
+ * Opening a conversion costs a lot more than converting the few bytes of
+ * a typical header word, so keep the last few descriptors around and
+ * hand them out again. A descriptor is used by one caller at a time and
+ * must be given back with mutt_iconv_close().
+ */
+#define ICONV_CACHE_LEN 8
+
+static struct {
+  char tocode[SHORT_STRING];    /* canonical, empty if slot unused */
+  char fromcode[SHORT_STRING];
+  iconv_t cd;
+  unsigned long used;           /* for LRU replacement */
+  unsigned int busy:1;
+} IconvCache[ICONV_CACHE_LEN];
+
+static unsigned long IconvUsed = 0;
+
+static iconv_t iconv_cache_get (const char *tocode, const char *fromcode)
+{
+  int i;
+
+  for (i = 0; i < ICONV_CACHE_LEN; i++)
+    if (!IconvCache[i].busy && *IconvCache[i].tocode &&
+        !str_cmp (IconvCache[i].tocode, tocode) &&
+        !str_cmp (IconvCache[i].fromcode, fromcode)) {
+      IconvCache[i].busy = 1;
+      IconvCache[i].used = ++IconvUsed;
+      return IconvCache[i].cd;
+    }
+  return (iconv_t) - 1;
+}
+
+static void iconv_cache_add (const char *tocode, const char *fromcode,
+                             iconv_t cd)
+{
+  int i, slot = -1;
+
+  /* prefer an unused slot, else replace the least recently used one */
+  for (i = 0; i < ICONV_CACHE_LEN; i++) {
+    if (IconvCache[i].busy)
+      continue;
+    if (!*IconvCache[i].tocode) {
+      slot = i;
+      break;
+    }
+    if (slot < 0 || IconvCache[i].used < IconvCache[slot].used)
+      slot = i;
+  }
+  /* all in use: caller gets an uncached descriptor */
+  if (slot < 0)
+    return;
+
+  if (*IconvCache[slot].tocode)
+    iconv_close (IconvCache[slot].cd);
+  strfcpy (IconvCache[slot].tocode, tocode, sizeof (IconvCache[slot].tocode));
+  strfcpy (IconvCache[slot].fromcode, fromcode,
+           sizeof (IconvCache[slot].fromcode));
+  IconvCache[slot].cd = cd;
+  IconvCache[slot].used = ++IconvUsed;
+  IconvCache[slot].busy = 1;
+}
+
 /*
  * Like iconv_open, but canonicalises the charsets
  */
@@ -299,8 +362,14 @@ iconv_t mutt_iconv_open (const char *tocode, const char *fromcode, int flags)
   if ((flags & M_ICONV_HOOK_FROM) && (tmp = mutt_charset_hook (fromcode1)))
     mutt_canonical_charset (fromcode1, sizeof (fromcode1), tmp);
 
-  if ((cd = iconv_open (tocode1, fromcode1)) != (iconv_t) - 1)
+  if ((cd = iconv_cache_get (tocode1, fromcode1)) != (iconv_t) - 1)
+    return cd;
+
+  if ((cd = iconv_open (tocode1, fromcode1)) != (iconv_t) - 1) {
+    iconv_cache_add (tocode1, fromcode1, cd);
     return cd;
+  }
+  /* not cached as iconv-hooks may change any time */
   if ((tocode2 = mutt_iconv_hook (tocode1))
       && (fromcode2 = mutt_iconv_hook (fromcode1)))
     return iconv_open (tocode2, fromcode2);
@@ -308,6 +377,27 @@ iconv_t mutt_iconv_open (const char *tocode, const char *fromcode, int flags)
   return (iconv_t) - 1;
 }
 
+/*
+ * Gives back a descriptor obtained from mutt_iconv_open(): cached ones
+ * get their conversion state reset for the next user, others are closed
+ */
+
+void mutt_iconv_close (iconv_t cd)
+{
+  int i;
+
+  if (cd == (iconv_t) - 1)
+    return;
+
+  for (i = 0; i < ICONV_CACHE_LEN; i++)
+    if (IconvCache[i].busy && IconvCache[i].cd == cd) {
+      iconv (cd, 0, 0, 0, 0);
+      IconvCache[i].busy = 0;
+      return;
+    }
+  iconv_close (cd);
+}
+
 
 /*
  * Like iconv, but keeps going even when the input is invalid
@@ -413,7 +503,7 @@ int mutt_convert_string (char **ps, const char *from, const char *to,
     ob = buf = mem_malloc (obl + 1);
 
     mutt_iconv (cd, &ib, &ibl, &ob, &obl, inrepls, outrepl);
-    iconv_close (cd);
+    mutt_iconv_close (cd);
 
     *ob = '\0';
 
@@ -436,8 +526,8 @@ int mutt_convert_string (char **ps, const char *from, const char *to,
 struct fgetconv_s {
   FILE *file;
   iconv_t cd;
-  char bufi[512];
-  char bufo[512];
+  char bufi[4096];
+  char bufo[4096];
   char *p;
   char *ob;
   char *ib;
@@ -494,6 +584,40 @@ char *fgetconvs (char *buf, size_t l, FGETCONV * _fc)
     return NULL;
 }
 
+/*
+ * Read up to l converted bytes into buf, copying whole runs out of the
+ * conversion buffer instead of going through fgetconv() byte by byte.
+ * Returns the number of bytes read, 0 at EOF.
+ */
+size_t fgetconvb (char *buf, size_t l, FGETCONV * _fc)
+{
+  struct fgetconv_s *fc = (struct fgetconv_s *) _fc;
+  size_t r = 0, n;
+  int c;
+
+  if (!fc)
+    return 0;
+  if (fc->cd == (iconv_t) - 1)
+    return fread (buf, 1, l, fc->file);
+
+  while (r < l) {
+    if (fc->p && fc->p < fc->ob) {
+      n = fc->ob - fc->p;
+      if (n > l - r)
+        n = l - r;
+      memcpy (buf + r, fc->p, n);
+      fc->p += n;
+      r += n;
+    }
+    /* let fgetconv() refill the conversion buffer */
+    else if ((c = fgetconv (_fc)) != EOF)
+      buf[r++] = (char) c;
+    else
+      break;
+  }
+  return r;
+}
+
 int fgetconv (FGETCONV * _fc)
 {
   struct fgetconv_s *fc = (struct fgetconv_s *) _fc;
@@ -551,8 +675,7 @@ void fgetconv_close (FGETCONV ** _fc)
 {
   struct fgetconv_s *fc = (struct fgetconv_s *) *_fc;
 
-  if (fc->cd != (iconv_t) - 1)
-    iconv_close (fc->cd);
+  mutt_iconv_close (fc->cd);
   mem_free (_fc);
 }
 
@@ -588,7 +711,7 @@ static size_t convert_string (ICONV_CONST char *f, size_t flen,
   if (n == (size_t) (-1) || iconv (cd, 0, 0, &ob, &obl) == (size_t) (-1)) {
     e = errno;
     mem_free (&buf);
-    iconv_close (cd);
+    mutt_iconv_close (cd);
     errno = e;
     return (size_t) (-1);
   }
@@ -598,7 +721,7 @@ static size_t convert_string (ICONV_CONST char *f, size_t flen,
 
   mem_realloc (&buf, ob - buf + 1);
   *t = buf;
-  iconv_close (cd);
+  mutt_iconv_close (cd);
 
   return n;
 }
@@ -30,6 +30,7 @@ char *mutt_get_first_charset (const char *);
 int mutt_convert_nonmime_string (char **);
 
 iconv_t mutt_iconv_open (const char *, const char *, int);
+void mutt_iconv_close (iconv_t);
 size_t mutt_iconv (iconv_t, ICONV_CONST char **, size_t *, char **, size_t *,
                    ICONV_CONST char **, const char *);
 
@@ -38,6 +39,7 @@ typedef void *FGETCONV;
 FGETCONV *fgetconv_open (FILE *, const char *, const char *, int);
 int fgetconv (FGETCONV *);
 char *fgetconvs (char *, size_t, FGETCONV *);
+size_t fgetconvb (char *, size_t, FGETCONV *);
 void fgetconv_close (FGETCONV **);
 
 void mutt_set_langinfo_charset (void);
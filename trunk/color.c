@@ -33,6 +33,8 @@ int ColorDefs[MT_COLOR_MAX];
 COLOR_LINE *ColorHdrList = NULL;
 COLOR_LINE *ColorBodyList = NULL;
 COLOR_LINE *ColorIndexList = NULL;
+/* bumped whenever index colors change, invalidating all HEADER.pair */
+unsigned int ColorIndexGen = 1;
 
 /* local to this file */
 static int ColorQuoteSize;
@@ -96,6 +98,13 @@ static struct mapping_t Fields[] = {
 
 #define COLOR_QUOTE_INIT	8
 
+void mutt_index_colors_changed (void)
+{
+  /* 0 is reserved for headers never resolved */
+  if (++ColorIndexGen == 0)
+    ColorIndexGen = 1;
+}
+
 static COLOR_LINE *mutt_new_color_line (void)
 {
   COLOR_LINE *p = mem_calloc (1, sizeof (COLOR_LINE));
@@ -432,12 +441,9 @@ _mutt_parse_uncolor (BUFFER * buf, BUFFER * s, unsigned long data,
 
 
   if (do_cache && !option (OPTNOCURSES)) {
-    int i;
-
     set_option (OPTFORCEREDRAWINDEX);
     /* force re-caching of index colors */
-    for (i = 0; Context && i < Context->msgcount; i++)
-      Context->hdrs[i]->pair = 0;
+    mutt_index_colors_changed ();
   }
   return (0);
 }
@@ -480,6 +486,8 @@ add_pattern (COLOR_LINE ** top, const char *s, int sensitive,
     }
 #endif /* HAVE_COLOR */
     tmp->pair = attr;
+    if (is_index)
+      mutt_index_colors_changed ();
   }
   else {
     int r;
@@ -487,8 +495,6 @@ add_pattern (COLOR_LINE ** top, const char *s, int sensitive,
 
     tmp = mutt_new_color_line ();
     if (is_index) {
-      int i;
-
       strfcpy (buf, NONULL (s), sizeof (buf));
       mutt_check_simple (buf, sizeof (buf), NONULL (SimpleSearch));
       if ((tmp->color_pattern =
@@ -497,8 +503,7 @@ add_pattern (COLOR_LINE ** top, const char *s, int sensitive,
         return -1;
       }
       /* force re-caching of index colors */
-      for (i = 0; Context && i < Context->msgcount; i++)
-        Context->hdrs[i]->pair = 0;
+      mutt_index_colors_changed ();
     }
     else
       if ((r =
@@ -718,8 +723,12 @@ _mutt_parse_color (BUFFER * buf, BUFFER * s, BUFFER * err,
     else
       ColorQuote[q_level] = fgbgattr_to_color (fg, bg, attr);
   }
-  else
+  else {
     ColorDefs[object] = fgbgattr_to_color (fg, bg, attr);
+    /* index entries without color use the normal one */
+    if (object == MT_COLOR_NORMAL)
+      mutt_index_colors_changed ();
+  }
 
 #ifdef HAVE_COLOR
 # ifdef HAVE_BKGDSET
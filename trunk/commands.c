@@ -180,7 +180,7 @@ int mutt_display_message (HEADER * cur)
 
     /* Remove color cache for this message, in case there
        are color patterns for both ~g and ~V */
-    cur->pair = 0;
+    cur->pair_gen = 0;
   }
 
   if (builtin) {
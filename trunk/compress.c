@@ -25,11 +25,16 @@
 #include <unistd.h>
 #include <sys/stat.h>
 
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
 typedef struct {
   const char *close;            /* close-hook  command */
   const char *open;             /* open-hook   command */
   const char *append;           /* append-hook command */
   off_t size;                   /* size of real folder */
+  int gzip;                     /* folder handled by the built-in codec */
 } COMPRESS_INFO;
 
 char echo_cmd[HUGE_STRING];
@@ -75,6 +80,101 @@ static const char *find_compress_hook (int type, const char *path)
   return (!c || !*c) ? NULL : c;
 }
 
+#ifdef HAVE_LIBZ
+#define GZ_BLOCK (64 * 1024)
+
+/*
+ * gzip'ed folders are decompressed and compressed in-process in blocks
+ * instead of running the hooks through a shell; existing folders are
+ * recognized by their magic, new ones by their .gz suffix
+ */
+static int is_gzip (const char *path)
+{
+  unsigned char magic[2];
+  FILE *fp;
+  int r = 0;
+
+  if (is_new (path)) {
+    size_t len = str_len (path);
+
+    return (len > 3 && !str_cmp (path + len - 3, ".gz"));
+  }
+  if ((fp = fopen (path, "r"))) {
+    r = (fread (magic, 1, 2, fp) == 2 && magic[0] == 0x1f && magic[1] == 0x8b);
+    fclose (fp);
+  }
+  return (r);
+}
+
+/* decompress all members of the gzip file src into dst */
+static int gz_decompress (const char *src, const char *dst)
+{
+  char *buf;
+  gzFile in;
+  FILE *out;
+  int n, rc = 0;
+
+  if ((in = gzopen (src, "rb")) == NULL)
+    return (-1);
+  if ((out = safe_fopen (dst, "w")) == NULL) {
+    gzclose (in);
+    return (-1);
+  }
+  gzbuffer (in, GZ_BLOCK);
+  buf = mem_malloc (GZ_BLOCK);
+  while ((n = gzread (in, buf, GZ_BLOCK)) > 0)
+    if (fwrite (buf, 1, n, out) != (size_t) n) {
+      rc = -1;
+      break;
+    }
+  if (n < 0)
+    rc = -1;
+  mem_free (&buf);
+  gzclose (in);
+  if (fclose (out) != 0)
+    rc = -1;
+  return (rc);
+}
+
+/*
+ * compress src into dst; mode "ab" adds a new gzip member to the end of
+ * an existing folder, which gzip and zlib transparently concatenate
+ */
+static int gz_compress (const char *src, const char *dst, const char *mode)
+{
+  char *buf;
+  FILE *in;
+  gzFile out;
+  size_t n;
+  int rc = 0;
+
+  if ((in = fopen (src, "r")) == NULL)
+    return (-1);
+  if ((out = gzopen (dst, mode)) == NULL) {
+    fclose (in);
+    return (-1);
+  }
+  gzbuffer (out, GZ_BLOCK);
+  buf = mem_malloc (GZ_BLOCK);
+  while ((n = fread (buf, 1, GZ_BLOCK, in)) > 0)
+    if (gzwrite (out, buf, n) != (int) n) {
+      rc = -1;
+      break;
+    }
+  if (ferror (in))
+    rc = -1;
+  mem_free (&buf);
+  fclose (in);
+  if (gzclose (out) != Z_OK)
+    rc = -1;
+  return (rc);
+}
+#else
+#define is_gzip(path) 0
+#define gz_decompress(src,dst) -1
+#define gz_compress(src,dst,mode) -1
+#endif /* HAVE_LIBZ */
+
 int mutt_can_read_compressed (const char *path)
 {
   return find_compress_hook (M_OPENHOOK, path) ? 1 : 0;
@@ -95,7 +195,9 @@ int mutt_can_append_compressed (const char *path)
   int magic;
 
   if (is_new (path))
-    return (find_compress_hook (M_CLOSEHOOK, path) ? 1 : 0);
+    return (find_compress_hook (M_CLOSEHOOK, path)
+            || (find_compress_hook (M_OPENHOOK, path) && is_gzip (path)))
+      ? 1 : 0;
 
   magic = mx_get_magic (path);
 
@@ -103,6 +205,7 @@ int mutt_can_append_compressed (const char *path)
     return 0;
 
   return (find_compress_hook (M_APPENDHOOK, path)
+          || (find_compress_hook (M_OPENHOOK, path) && is_gzip (path))
           || (find_compress_hook (M_OPENHOOK, path)
               && find_compress_hook (M_CLOSEHOOK, path))) ? 1 : 0;
 }
@@ -118,6 +221,7 @@ static COMPRESS_INFO *set_compress_info (CONTEXT * ctx)
   ci->append = find_compress_hook (M_APPENDHOOK, ctx->path);
   ci->open = find_compress_hook (M_OPENHOOK, ctx->path);
   ci->close = find_compress_hook (M_CLOSEHOOK, ctx->path);
+  ci->gzip = is_gzip (ctx->path);
   return ci;
 }
 
@@ -219,7 +323,7 @@ int mutt_open_read_compressed (CONTEXT * ctx)
     mem_free (ctx->compressinfo);
     return (-1);
   }
-  if (!ci->close || access (ctx->path, W_OK) != 0)
+  if ((!ci->close && !ci->gzip) || access (ctx->path, W_OK) != 0)
     ctx->readonly = 1;
 
   set_path (ctx);
@@ -248,17 +352,22 @@ int mutt_open_read_compressed (CONTEXT * ctx)
     return (-1);
   }
 
-  endwin ();
-  fflush (stdout);
-  sprintf (echo_cmd, _("echo Decompressing %s..."), ctx->realpath);
-  mutt_system (echo_cmd);
-  rc = mutt_system (cmd);
+  if (ci->gzip)
+    rc = gz_decompress (ctx->realpath, ctx->path);
+  else {
+    endwin ();
+    fflush (stdout);
+    sprintf (echo_cmd, _("echo Decompressing %s..."), ctx->realpath);
+    mutt_system (echo_cmd);
+    rc = mutt_system (cmd);
+  }
   mbox_unlock_compressed (ctx, fp);
   mutt_unblock_signals ();
   fclose (fp);
 
   if (rc) {
-    mutt_any_key_to_continue (NULL);
+    if (!ci->gzip)
+      mutt_any_key_to_continue (NULL);
     ctx->magic = 0;
     mem_free (ctx->compressinfo);
     mutt_error (_("Error executing: %s : unable to open the mailbox!\n"),
@@ -294,7 +403,7 @@ int mutt_open_append_compressed (CONTEXT * ctx)
   FILE *fh;
   COMPRESS_INFO *ci = set_compress_info (ctx);
 
-  if (!get_append_command (ctx->path, ctx)) {
+  if (!ci->gzip && !get_append_command (ctx->path, ctx)) {
     if (ci->open && ci->close)
       return (mutt_open_read_compressed (ctx));
 
@@ -347,8 +456,9 @@ int mutt_sync_compressed (CONTEXT * ctx)
   if (!ctx->quiet)
     mutt_message (_("Compressing %s..."), ctx->realpath);
 
-  cmd = get_compression_cmd (ci->close, ctx);
-  if (cmd == NULL)
+  if (ci->gzip)
+    cmd = NULL;
+  else if ((cmd = get_compression_cmd (ci->close, ctx)) == NULL)
     return (-1);
 
   if ((fp = fopen (ctx->realpath, "a")) == NULL) {
@@ -368,14 +478,18 @@ int mutt_sync_compressed (CONTEXT * ctx)
     return (-1);
   }
 
-  debug_print (2, ("CompressCommand: '%s'\n", cmd));
-
-  endwin ();
-  fflush (stdout);
-  sprintf (echo_cmd, _("echo Compressing %s..."), ctx->realpath);
-  mutt_system (echo_cmd);
-  if (mutt_system (cmd)) {
-    mutt_any_key_to_continue (NULL);
+  if (ci->gzip)
+    rc = gz_compress (ctx->path, ctx->realpath, "wb");
+  else {
+    debug_print (2, ("CompressCommand: '%s'\n", cmd));
+    endwin ();
+    fflush (stdout);
+    sprintf (echo_cmd, _("echo Compressing %s..."), ctx->realpath);
+    mutt_system (echo_cmd);
+    if ((rc = mutt_system (cmd)))
+      mutt_any_key_to_continue (NULL);
+  }
+  if (rc) {
     mutt_error (_
                 ("%s: Error compressing mailbox! Original mailbox deleted, uncompressed one kept!\n"),
                 ctx->path);
@@ -399,10 +513,14 @@ int mutt_slow_close_compressed (CONTEXT * ctx)
   const char *append;
   char *cmd;
   COMPRESS_INFO *ci = (COMPRESS_INFO *) ctx->compressinfo;
+  int rc;
 
   debug_print (2, ("called on '%s'\n", ctx->path));
 
-  if (!(ctx->append && ((append = get_append_command (ctx->realpath, ctx))
+  if (ci->gzip)
+    append = is_new (ctx->realpath) ? ci->close : ci->append;
+  if (!(ctx->append && (ci->gzip
+                        || (append = get_append_command (ctx->realpath, ctx))
                         || (append = ci->close)))) {    /* if we can not or should not append,
                                                          * we only have to remove the compressed info, because sync was already
                                                          * called 
@@ -422,8 +540,9 @@ int mutt_slow_close_compressed (CONTEXT * ctx)
       mutt_message (_("Compressed-appending to %s..."), ctx->realpath);
   }
 
-  cmd = get_compression_cmd (append, ctx);
-  if (cmd == NULL)
+  if (ci->gzip)
+    cmd = NULL;
+  else if ((cmd = get_compression_cmd (append, ctx)) == NULL)
     return (-1);
 
   if ((fp = fopen (ctx->realpath, "a")) == NULL) {
@@ -441,20 +560,26 @@ int mutt_slow_close_compressed (CONTEXT * ctx)
     return (-1);
   }
 
-  debug_print (2, ("CompressCmd: '%s'\n", cmd));
+  if (ci->gzip)
+    /* a new member is added rather than recompressing the folder */
+    rc = gz_compress (ctx->path, ctx->realpath, "ab");
+  else {
+    debug_print (2, ("CompressCmd: '%s'\n", cmd));
 
-  endwin ();
-  fflush (stdout);
+    endwin ();
+    fflush (stdout);
 
-  if (append == ci->close)
-    sprintf (echo_cmd, _("echo Compressing %s..."), ctx->realpath);
-  else
-    sprintf (echo_cmd, _("echo Compressed-appending to %s..."),
-             ctx->realpath);
-  mutt_system (echo_cmd);
+    if (append == ci->close)
+      sprintf (echo_cmd, _("echo Compressing %s..."), ctx->realpath);
+    else
+      sprintf (echo_cmd, _("echo Compressed-appending to %s..."),
+               ctx->realpath);
+    mutt_system (echo_cmd);
 
-  if (mutt_system (cmd)) {
-    mutt_any_key_to_continue (NULL);
+    if ((rc = mutt_system (cmd)))
+      mutt_any_key_to_continue (NULL);
+  }
+  if (rc) {
     mutt_error (_
                 (" %s: Error compressing mailbox!  Uncompressed one kept!\n"),
                 ctx->path);
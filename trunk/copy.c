@@ -319,6 +319,7 @@ mutt_copy_hdr (FILE* in, FILE* out, LOFF_T off_start, LOFF_T off_end,
 	CH_NOLEN	don't write Content-Length: and Lines:
  	CH_NONEWLINE	don't output a newline after the header
  	CH_NOSTATUS	ignore the Status: and X-Status:
+ 	CH_PADSTATUS	with CH_UPDATE, always write padded Status: and X-Status:
  	CH_PREFIX	quote header with $indent_str
  	CH_REORDER	output header in order specified by `hdr_order'
   	CH_TXTPLAIN	generate text/plain MIME headers [hack alert.]
@@ -407,39 +408,50 @@ mutt_copy_header (FILE * in, HEADER * h, FILE * out, int flags,
           return (-1);
       }
 
-      if (h->old || h->read) {
-        if (fputs ("Status: ", out) == EOF)
+      if (flags & CH_PADSTATUS) {
+        /* always write both fields with room for every flag, so that
+         * flag changes can later be written over them in place */
+        if (fprintf (out, "Status: %-2s\n", h->read ? "RO" :
+                     h->old ? "O" : "") < 0 ||
+            fprintf (out, "X-Status: %-2s\n", h->replied ?
+                     (h->flagged ? "AF" : "A") : h->flagged ? "F" : "") < 0)
           return (-1);
-
-        if (h->read) {
-          if (fputs ("RO", out) == EOF)
+      }
+      else {
+        if (h->old || h->read) {
+          if (fputs ("Status: ", out) == EOF)
             return (-1);
-        }
-        else if (h->old) {
-          if (fputc ('O', out) == EOF)
+
+          if (h->read) {
+            if (fputs ("RO", out) == EOF)
+              return (-1);
+          }
+          else if (h->old) {
+            if (fputc ('O', out) == EOF)
+              return (-1);
+          }
+
+          if (fputc ('\n', out) == EOF)
             return (-1);
         }
 
-        if (fputc ('\n', out) == EOF)
-          return (-1);
-      }
+        if (h->flagged || h->replied) {
+          if (fputs ("X-Status: ", out) == EOF)
+            return (-1);
 
-      if (h->flagged || h->replied) {
-        if (fputs ("X-Status: ", out) == EOF)
-          return (-1);
+          if (h->replied) {
+            if (fputc ('A', out) == EOF)
+              return (-1);
+          }
 
-        if (h->replied) {
-          if (fputc ('A', out) == EOF)
-            return (-1);
-        }
+          if (h->flagged) {
+            if (fputc ('F', out) == EOF)
+              return (-1);
+          }
 
-        if (h->flagged) {
-          if (fputc ('F', out) == EOF)
+          if (fputc ('\n', out) == EOF)
             return (-1);
         }
-
-        if (fputc ('\n', out) == EOF)
-          return (-1);
       }
     }
   }
@@ -731,7 +743,7 @@ _mutt_append_message (CONTEXT * dest, FILE * fpin, CONTEXT * src,
   if ((msg = mx_open_new_message (dest, hdr, is_from (buf, NULL, 0, NULL) ? 0 : M_ADD_FROM)) == NULL)
     return (-1);
   if (dest->magic == M_MBOX || dest->magic == M_MMDF)
-    chflags |= CH_FROM | CH_FORCE_FROM;
+    chflags |= CH_FROM | CH_FORCE_FROM | CH_PADSTATUS;
   chflags |= (dest->magic == M_MAILDIR ? CH_NOSTATUS : CH_UPDATE);
   r = _mutt_copy_message (msg->fp, fpin, hdr, body, flags, chflags);
   if (mx_commit_message (msg, dest) != 0)
@@ -28,6 +28,7 @@
 #define CH_NOQFROM              (1<<15) /* give CH_FROM precedence over CH_WEED? */
 #define CH_UPDATE_IRT           (1<<16) /* update In-Reply-To: */
 #define CH_UPDATE_REFS          (1<<17) /* update References: */
+#define CH_PADSTATUS            (1<<18) /* pad Status: and X-Status: for in-place updates */
 
 /* flags to _mutt_copy_message */
 #define M_CM_NOHEADER           (1<<0)  /* don't copy the message header */
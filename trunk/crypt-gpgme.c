@@ -30,6 +30,7 @@
 #include "pager.h"
 #include "recvattach.h"
 #include "sort.h"
+#include "md5.h"
 
 #include "lib/mem.h"
 #include "lib/intl.h"
@@ -110,8 +111,27 @@ typedef struct crypt_entry {
 } crypt_entry_t;
 
 
+/* Outcome of a signature verification, remembered by the digest of
+   the signature and the signed data so that displaying the same
+   message again doesn't run the engine again. */
+struct verify_cache {
+  unsigned char digest[16];
+  int result;
+  char *output;
+  gpgme_key_t key;              /* the signature_key it left behind */
+  struct verify_cache *next;
+};
+
+#define VERIFY_CACHE_MAX 16
+
 static struct crypt_cache *id_defaults = NULL;
 static gpgme_key_t signature_key = NULL;
+static struct verify_cache *verify_results = NULL;
+
+/* Contexts kept for reuse by verification, decryption and key listing,
+   one per protocol.  Those which get signers, armor or text mode set
+   are still created fresh. */
+static gpgme_ctx_t idle_context[2] = { NULL, NULL };
 
 /*
  * General helper functions.
@@ -233,7 +253,7 @@ static void crypt_free_key (crypt_key_t ** keylist)
   while (*keylist) {
     crypt_key_t *k = (*keylist)->next;
 
-    mem_free (&k);
+    mem_free (keylist);
     *keylist = k;
   }
 }
@@ -315,8 +335,9 @@ static int crypt_id_matches_addr (ADDRESS * addr, ADDRESS * u_addr,
  */
 
 /* Create a new gpgme context and return it.  With FOR_SMIME set to
-   true, the protocol of the context is set to CMS. */
-static gpgme_ctx_t create_gpgme_context (int for_smime)
+   true, the protocol of the context is set to CMS.  On error, report
+   it and return NULL. */
+static gpgme_ctx_t new_gpgme_context (int for_smime)
 {
   gpgme_error_t err;
   gpgme_ctx_t ctx;
@@ -324,22 +345,68 @@ static gpgme_ctx_t create_gpgme_context (int for_smime)
   err = gpgme_new (&ctx);
   if (err) {
     mutt_error (_("error creating gpgme context: %s\n"), gpgme_strerror (err));
-    sleep (2);
-    mutt_exit (1);
+    return NULL;
   }
 
   if (for_smime) {
     err = gpgme_set_protocol (ctx, GPGME_PROTOCOL_CMS);
     if (err) {
       mutt_error (_("error enabling CMS protocol: %s\n"), gpgme_strerror (err));
-      sleep (2);
-      mutt_exit (1);
+      gpgme_release (ctx);
+      return NULL;
     }
   }
 
   return ctx;
 }
 
+/* Like new_gpgme_context(), but die on error. */
+static gpgme_ctx_t create_gpgme_context (int for_smime)
+{
+  gpgme_ctx_t ctx;
+
+  if (!(ctx = new_gpgme_context (for_smime))) {
+    sleep (2);
+    mutt_exit (1);
+  }
+  return ctx;
+}
+
+/* Return an idle context for the protocol, creating one if there is
+   none, or NULL if that fails.  Hand it back with
+   release_gpgme_context(). */
+static gpgme_ctx_t try_gpgme_context (int for_smime)
+{
+  gpgme_ctx_t ctx;
+
+  if ((ctx = idle_context[for_smime ? 1 : 0]))
+    idle_context[for_smime ? 1 : 0] = NULL;
+  else
+    ctx = new_gpgme_context (for_smime);
+
+  return ctx;
+}
+
+/* Like try_gpgme_context(), but die on error. */
+static gpgme_ctx_t get_gpgme_context (int for_smime)
+{
+  gpgme_ctx_t ctx;
+
+  if (!(ctx = try_gpgme_context (for_smime))) {
+    sleep (2);
+    mutt_exit (1);
+  }
+  return ctx;
+}
+
+static void release_gpgme_context (gpgme_ctx_t ctx, int for_smime)
+{
+  if (idle_context[for_smime ? 1 : 0])
+    gpgme_release (ctx);
+  else
+    idle_context[for_smime ? 1 : 0] = ctx;
+}
+
 /* Create a new gpgme data object.  This is a wrapper to die on
    error. */
 static gpgme_data_t create_gpgme_data (void)
@@ -1220,9 +1287,10 @@ static int show_one_sig_status (gpgme_ctx_t ctx, int idx, STATE * s)
 }
 
 /* Do the actual verification step. With IS_SMIME set to true we
-   assume S/MIME (surprise!) */
-static int verify_one (BODY * sigbdy, STATE * s,
-                       const char *tempfile, int is_smime)
+   assume S/MIME (surprise!).  *R_VERIFIED is set when the engine
+   did run, i.e. the result is worth remembering. */
+static int _verify_one (BODY * sigbdy, STATE * s,
+                        const char *tempfile, int is_smime, int *r_verified)
 {
   int badsig = -1;
   int anywarn = 0;
@@ -1230,6 +1298,8 @@ static int verify_one (BODY * sigbdy, STATE * s,
   gpgme_ctx_t ctx;
   gpgme_data_t signature, message;
 
+  *r_verified = 0;
+
   signature = file_to_data_object (s->fpin, sigbdy->offset, sigbdy->length);
   if (!signature)
     return -1;
@@ -1245,7 +1315,7 @@ static int verify_one (BODY * sigbdy, STATE * s,
     mutt_error (_("error allocating data object: %s\n"), gpgme_strerror (err));
     return -1;
   }
-  ctx = create_gpgme_context (is_smime);
+  ctx = get_gpgme_context (is_smime);
 
   /* Note: We don't need a current time output because GPGME avoids
      such an attack by separating the meta information from the
@@ -1265,6 +1335,7 @@ static int verify_one (BODY * sigbdy, STATE * s,
     int res, idx;
     int anybad = 0;
 
+    *r_verified = 1;
     if (signature_key) {
       gpgme_key_release (signature_key);
       signature_key = NULL;
@@ -1313,7 +1384,9 @@ static int verify_one (BODY * sigbdy, STATE * s,
     }
   }
 
-  gpgme_release (ctx);
+  gpgme_data_release (signature);
+  gpgme_data_release (message);
+  release_gpgme_context (ctx, is_smime);
 
   state_attach_puts (_("[-- End signature information --]\n\n"), s);
   debug_print (1, ("returning %d.\n", badsig));
@@ -1321,6 +1394,153 @@ static int verify_one (BODY * sigbdy, STATE * s,
   return badsig ? 1 : anywarn ? 2 : 0;
 }
 
+static void verify_digest_file (MD5_CTX * md5, FILE * fp, long length)
+{
+  unsigned char buf[4096];
+  size_t n;
+
+  while (length && (n = fread (buf, 1, length > 0 && length < sizeof (buf) ?
+                               length : sizeof (buf), fp)) > 0) {
+    MD5Update (md5, buf, n);
+    if (length > 0)
+      length -= n;
+  }
+}
+
+/* Keyrings and trust databases of gpg and gpgsm.  Importing a key or
+   editing its trust changes one of them, and with it the outcome of
+   a verification, so their state goes into the digest. */
+static const char *verify_keyrings[] = {
+  "pubring.gpg", "pubring.kbx", "trustdb.gpg", "trustlist.txt", NULL
+};
+
+static void verify_digest_keyrings (MD5_CTX * md5)
+{
+  char path[_POSIX_PATH_MAX];
+  const char *home = getenv ("GNUPGHOME");
+  struct stat st;
+  int i;
+
+  for (i = 0; verify_keyrings[i]; i++) {
+    if (home && *home)
+      snprintf (path, sizeof (path), "%s/%s", home, verify_keyrings[i]);
+    else
+      snprintf (path, sizeof (path), "%s/.gnupg/%s", NONULL (Homedir),
+                verify_keyrings[i]);
+    if (stat (path, &st) == -1)
+      memset (&st, 0, sizeof (st));
+    MD5Update (md5, (unsigned char *) &st.st_ino, sizeof (st.st_ino));
+    MD5Update (md5, (unsigned char *) &st.st_size, sizeof (st.st_size));
+    MD5Update (md5, (unsigned char *) &st.st_mtime, sizeof (st.st_mtime));
+  }
+}
+
+/* Digest over everything the outcome of a verification depends on. */
+static int verify_digest (unsigned char *digest, BODY * sigbdy, STATE * s,
+                          const char *tempfile, int is_smime)
+{
+  MD5_CTX md5;
+  FILE *fp;
+  long pos;
+  unsigned char flags[2];
+
+  if (!(fp = fopen (tempfile, "r")))
+    return -1;
+
+  flags[0] = is_smime;
+  flags[1] = (s->flags & M_DISPLAY) ? 1 : 0;
+  MD5Init (&md5);
+  MD5Update (&md5, flags, sizeof (flags));
+  verify_digest_keyrings (&md5);
+
+  pos = ftell (s->fpin);
+  fseek (s->fpin, sigbdy->offset, 0);
+  verify_digest_file (&md5, s->fpin, sigbdy->length);
+  fseek (s->fpin, pos, 0);
+
+  verify_digest_file (&md5, fp, -1);
+  fclose (fp);
+
+  MD5Final (digest, &md5);
+  return 0;
+}
+
+static void verify_cache_add (unsigned char *digest, int result,
+                              char *output)
+{
+  struct verify_cache *c, **p;
+  int i;
+
+  c = mem_calloc (1, sizeof (struct verify_cache));
+  memcpy (c->digest, digest, sizeof (c->digest));
+  c->result = result;
+  c->output = output;
+  if ((c->key = signature_key))
+    gpgme_key_ref (c->key);
+  c->next = verify_results;
+  verify_results = c;
+
+  for (i = 0, p = &verify_results; *p && i < VERIFY_CACHE_MAX;
+       i++, p = &(*p)->next);
+  while ((c = *p)) {
+    *p = c->next;
+    if (c->key)
+      gpgme_key_release (c->key);
+    mem_free (&c->output);
+    mem_free (&c);
+  }
+}
+
+static int verify_one (BODY * sigbdy, STATE * s,
+                       const char *tempfile, int is_smime)
+{
+  unsigned char digest[16];
+  struct verify_cache *c;
+  char outfile[_POSIX_PATH_MAX];
+  char *output;
+  STATE vs;
+  long len;
+  int verified, r;
+
+  if (verify_digest (digest, sigbdy, s, tempfile, is_smime) == -1)
+    return _verify_one (sigbdy, s, tempfile, is_smime, &verified);
+
+  for (c = verify_results; c; c = c->next)
+    if (!memcmp (c->digest, digest, sizeof (digest))) {
+      debug_print (2, ("reusing verification result %d.\n", c->result));
+      if (signature_key)
+        gpgme_key_release (signature_key);
+      if ((signature_key = c->key))
+        gpgme_key_ref (signature_key);
+      state_puts (c->output, s);
+      return c->result;
+    }
+
+  /* run it with the output going to a file we can keep a copy of */
+  mutt_mktemp (outfile);
+  vs = *s;
+  if (!(vs.fpout = safe_fopen (outfile, "w+")))
+    return _verify_one (sigbdy, s, tempfile, is_smime, &verified);
+  unlink (outfile);
+
+  r = _verify_one (sigbdy, &vs, tempfile, is_smime, &verified);
+
+  len = ftell (vs.fpout);
+  output = mem_malloc (len + 1);
+  rewind (vs.fpout);
+  len = fread (output, 1, len, vs.fpout);
+  output[len] = '\0';
+  fclose (vs.fpout);
+
+  state_puts (output, s);
+  if (verified)
+    verify_cache_add (digest, r, output);
+  else
+    mem_free (&output);
+
+  return r;
+}
+
 int pgp_gpgme_verify_one (BODY * sigbdy, STATE * s, const char *tempfile)
 {
   return verify_one (sigbdy, s, tempfile, 0);
@@ -1356,13 +1576,15 @@ static BODY *decrypt_part (BODY * a, STATE * s, FILE * fpout, int is_smime,
   if (r_is_signed)
     *r_is_signed = 0;
 
-  ctx = create_gpgme_context (is_smime);
+  ctx = get_gpgme_context (is_smime);
 
 restart:
   /* Make a data object from the body, create context etc. */
   ciphertext = file_to_data_object (s->fpin, a->offset, a->length);
-  if (!ciphertext)
+  if (!ciphertext) {
+    release_gpgme_context (ctx, is_smime);
     return NULL;
+  }
   plaintext = create_gpgme_data ();
 
   /* Do the decryption or the verification in case of the S/MIME hack. */
@@ -1409,7 +1631,7 @@ restart:
       state_attach_puts (buf, s);
     }
     gpgme_data_release (plaintext);
-    gpgme_release (ctx);
+    release_gpgme_context (ctx, is_smime);
     return NULL;
   }
   mutt_need_hard_redraw ();
@@ -1418,7 +1640,7 @@ restart:
      otherwise read_mime_header has a hard time parsing the message.  */
   if (data_object_to_stream (plaintext, fpout)) {
     gpgme_data_release (plaintext);
-    gpgme_release (ctx);
+    release_gpgme_context (ctx, is_smime);
     return NULL;
   }
   gpgme_data_release (plaintext);
@@ -1447,7 +1669,7 @@ restart:
     if ((s->flags & M_DISPLAY))
       state_attach_puts (_("[-- End signature " "information --]\n\n"), s);
   }
-  gpgme_release (ctx);
+  release_gpgme_context (ctx, is_smime);
   ctx = NULL;
 
   fflush (fpout);
@@ -3084,13 +3306,6 @@ static crypt_key_t *get_candidates (LIST * hints, unsigned int app,
   if (!pattern)
     return NULL;
 
-  err = gpgme_new (&ctx);
-  if (err) {
-    mutt_error (_("gpgme_new failed: %s"), gpgme_strerror (err));
-    mem_free (&pattern);
-    return NULL;
-  }
-
   db = NULL;
   kend = &db;
 
@@ -3116,13 +3331,20 @@ static crypt_key_t *get_candidates (LIST * hints, unsigned int app,
         patarr[n++] = str_dup (l->data);
     }
     patarr[n] = NULL;
+    if (!(ctx = try_gpgme_context (0))) {
+      for (n = 0; patarr[n]; n++)
+        mem_free (&patarr[n]);
+      mem_free (&patarr);
+      mem_free (&pattern);
+      return NULL;
+    }
     err = gpgme_op_keylist_ext_start (ctx, (const char **) patarr, secret, 0);
     for (n = 0; patarr[n]; n++)
       mem_free (&patarr[n]);
     mem_free (&patarr);
     if (err) {
       mutt_error (_("gpgme_op_keylist_start failed: %s"), gpgme_strerror (err));
-      gpgme_release (ctx);
+      release_gpgme_context (ctx, 0);
       mem_free (&pattern);
       return NULL;
     }
@@ -3168,17 +3390,22 @@ static crypt_key_t *get_candidates (LIST * hints, unsigned int app,
     if (gpg_err_code (err) != GPG_ERR_EOF)
       mutt_error (_("gpgme_op_keylist_next failed: %s"), gpgme_strerror (err));
     gpgme_op_keylist_end (ctx);
+    release_gpgme_context (ctx, 0);
   no_pgphints:
     ;
   }
 
   if ((app & APPLICATION_SMIME)) {
     /* and now look for x509 certificates */
-    gpgme_set_protocol (ctx, GPGME_PROTOCOL_CMS);
+    if (!(ctx = try_gpgme_context (1))) {
+      crypt_free_key (&db);
+      mem_free (&pattern);
+      return NULL;
+    }
     err = gpgme_op_keylist_start (ctx, pattern, 0);
     if (err) {
       mutt_error (_("gpgme_op_keylist_start failed: %s"), gpgme_strerror (err));
-      gpgme_release (ctx);
+      release_gpgme_context (ctx, 1);
       mem_free (&pattern);
       return NULL;
     }
@@ -3204,9 +3431,9 @@ static crypt_key_t *get_candidates (LIST * hints, unsigned int app,
     if (gpg_err_code (err) != GPG_ERR_EOF)
       mutt_error (_("gpgme_op_keylist_next failed: %s"), gpgme_strerror (err));
     gpgme_op_keylist_end (ctx);
+    release_gpgme_context (ctx, 1);
   }
 
-  gpgme_release (ctx);
   mem_free (&pattern);
   return db;
 }
@@ -3426,8 +3653,11 @@ static crypt_key_t *crypt_select_key (crypt_key_t * keys,
   return k;
 }
 
+/* With CANDIDATES set, look for A among the keys it points to instead
+   of running a key listing of its own. */
 static crypt_key_t *crypt_getkeybyaddr (ADDRESS * a, short abilities,
-                                        unsigned int app, int *forced_valid)
+                                        unsigned int app, int *forced_valid,
+                                        crypt_key_t ** candidates)
 {
   ADDRESS *r, *p;
   LIST *hints = NULL;
@@ -3447,15 +3677,19 @@ static crypt_key_t *crypt_getkeybyaddr (ADDRESS * a, short abilities,
 
   *forced_valid = 0;
 
-  if (a && a->mailbox)
-    hints = crypt_add_string_to_hints (hints, a->mailbox);
-  if (a && a->personal)
-    hints = crypt_add_string_to_hints (hints, a->personal);
+  if (candidates)
+    keys = *candidates;
+  else {
+    if (a && a->mailbox)
+      hints = crypt_add_string_to_hints (hints, a->mailbox);
+    if (a && a->personal)
+      hints = crypt_add_string_to_hints (hints, a->personal);
 
-  mutt_message (_("Looking for keys matching \"%s\"..."), a->mailbox);
-  keys = get_candidates (hints, app, (abilities & KEYFLAG_CANSIGN));
+    mutt_message (_("Looking for keys matching \"%s\"..."), a->mailbox);
+    keys = get_candidates (hints, app, (abilities & KEYFLAG_CANSIGN));
 
-  mutt_free_list (&hints);
+    mutt_free_list (&hints);
+  }
 
   if (!keys)
     return NULL;
@@ -3515,7 +3749,8 @@ static crypt_key_t *crypt_getkeybyaddr (ADDRESS * a, short abilities,
     }
   }
 
-  crypt_free_key (&keys);
+  if (!candidates)
+    crypt_free_key (&keys);
 
   if (matches) {
     if (the_valid_key && !multi && !weak
@@ -3669,6 +3904,8 @@ static char *find_keys (ADDRESS * to, ADDRESS * cc, ADDRESS * bcc,
   ADDRESS *p, *q;
   int i;
   crypt_key_t *k_info, *key;
+  crypt_key_t *candidates;
+  LIST *hints = NULL;
   const char *fqdn = mutt_fqdn (1);
 
 #if 0
@@ -3700,6 +3937,18 @@ static char *find_keys (ADDRESS * to, ADDRESS * cc, ADDRESS * bcc,
 
   tmp = mutt_remove_duplicates (tmp);
 
+  /* one key listing for all recipients instead of one per address */
+  for (p = tmp; p; p = p->next) {
+    if (p->mailbox)
+      hints = crypt_add_string_to_hints (hints, p->mailbox);
+    if (p->personal)
+      hints = crypt_add_string_to_hints (hints, p->personal);
+  }
+  if (tmp)
+    mutt_message (_("Looking for keys matching \"%s\"..."), tmp->mailbox);
+  candidates = hints ? get_candidates (hints, app, 0) : NULL;
+  mutt_free_list (&hints);
+
   for (p = tmp; p; p = p->next) {
     char buf[LONG_STRING];
     int forced_valid = 0;
@@ -3732,15 +3981,18 @@ static char *find_keys (ADDRESS * to, ADDRESS * cc, ADDRESS * bcc,
       }
       else if (r == -1) {
         mem_free (&keylist);
+        crypt_free_key (&candidates);
         rfc822_free_address (&tmp);
         rfc822_free_address (&addr);
         return NULL;
       }
     }
 
+    /* an address from a crypt-hook isn't covered by the listing */
     if (k_info == NULL
         && (k_info = crypt_getkeybyaddr (q, KEYFLAG_CANENCRYPT,
-                                         app, &forced_valid)) == NULL) {
+                                         app, &forced_valid,
+                                         q == p ? &candidates : NULL)) == NULL) {
       snprintf (buf, sizeof (buf), _("Enter keyID for %s: "), q->mailbox);
 
       if ((key = crypt_ask_for_key (buf, q->mailbox, KEYFLAG_CANENCRYPT,
@@ -3751,6 +4003,7 @@ static char *find_keys (ADDRESS * to, ADDRESS * cc, ADDRESS * bcc,
 #endif
                                     &forced_valid)) == NULL) {
         mem_free (&keylist);
+        crypt_free_key (&candidates);
         rfc822_free_address (&tmp);
         rfc822_free_address (&addr);
         return NULL;
@@ -3779,6 +4032,7 @@ static char *find_keys (ADDRESS * to, ADDRESS * cc, ADDRESS * bcc,
     crypt_free_key (&key);
     rfc822_free_address (&addr);
   }
+  crypt_free_key (&candidates);
   rfc822_free_address (&tmp);
   return (keylist);
 }
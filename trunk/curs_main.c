@@ -176,7 +176,7 @@ int index_color (int index_no)
 {
   HEADER *h = Context->hdrs[Context->v2r[index_no]];
 
-  if (h && h->pair)
+  if (h && h->pair_gen == ColorIndexGen)
     return h->pair;
 
   mutt_set_header_color (Context, h);
@@ -2402,7 +2402,9 @@ void mutt_set_header_color (CONTEXT * ctx, HEADER * curhdr)
     if (mutt_pattern_exec
         (color->color_pattern, M_MATCH_FULL_ADDRESS, ctx, curhdr)) {
       curhdr->pair = color->pair;
+      curhdr->pair_gen = ColorIndexGen;
       return;
     }
   curhdr->pair = ColorDefs[MT_COLOR_NORMAL];
+  curhdr->pair_gen = ColorIndexGen;
 }
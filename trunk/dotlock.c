@@ -567,8 +567,6 @@ static int dotlock_deference_symlink (char *d, size_t l, const char *path)
  * 
  */
 
-#define HARDMAXATTEMPTS 10
-
 static int dotlock_lock (const char *realpath)
 {
   char lockfile[_POSIX_PATH_MAX + LONG_STRING];
@@ -578,7 +576,9 @@ static int dotlock_lock (const char *realpath)
   int count = 0;
   int hard_count = 0;
   struct stat sb;
+#ifdef DL_STANDALONE
   time_t t;
+#endif
 
   snprintf (nfslockfile, sizeof (nfslockfile), "%s.%s.%d",
             realpath, Hostname, (int) getpid ());
@@ -643,6 +643,7 @@ static int dotlock_lock (const char *realpath)
 
     prev_size = sb.st_size;
 
+#ifdef DL_STANDALONE
     /* don't trust sleep (3) as it may be interrupted
      * by users sending signals. 
      */
@@ -651,6 +652,9 @@ static int dotlock_lock (const char *realpath)
     do {
       sleep (1);
     } while (time (NULL) == t);
+#else
+    mx_wait_lockfile (lockfile);
+#endif
   }
 
   BEGIN_PRIVILEGED ();
@@ -30,6 +30,9 @@
 
 #define DL_FL_ACTIONS (DL_FL_TRY|DL_FL_UNLOCK|DL_FL_UNLINK)
 
+/* how often to try linking the lock file before giving up */
+#define HARDMAXATTEMPTS 10
+
 #ifndef DL_STANDALONE
 int dotlock_invoke (const char *, int, int, int);
 #endif
@@ -265,7 +265,8 @@ void _mutt_set_flag (CONTEXT * ctx, HEADER * h, int flag, int bf, int upd_ctx)
     break;
   }
 
-  mutt_set_header_color (ctx, h);
+  /* resolve the index color again when the message is displayed */
+  h->pair_gen = 0;
 
   /* if the message status has changed, we need to invalidate the cached
    * search results so that any future search will match the current status
@@ -71,6 +71,7 @@ WHERE char *Inbox;
 WHERE char *Ispell;
 WHERE char *Locale;
 WHERE char *MailcapPath;
+WHERE char *AutoViewCache;
 WHERE char *Maildir;
 
 #if USE_HCACHE
@@ -225,6 +226,7 @@ WHERE short NntpContext;
 #endif
 
 WHERE short ConnectTimeout;
+WHERE short AutoViewCacheSize;
 WHERE short HistSize;
 WHERE short MenuContext;
 WHERE short PagerContext;
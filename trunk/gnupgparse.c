@@ -100,7 +100,7 @@ static void fix_uid (char *uid)
         memcpy (uid, buf, n);
     }
     mem_free (&buf);
-    iconv_close (cd);
+    mutt_iconv_close (cd);
   }
 }
 
@@ -298,7 +298,7 @@ static pgp_key_t parse_pub_line (char *buf, int *is_subkey, pgp_key_t k)
   return k;
 }
 
-pgp_key_t pgp_get_candidates (pgp_ring_t keyring, LIST * hints)
+static pgp_key_t pgp_list_keys (pgp_ring_t keyring, LIST * hints)
 {
   FILE *fp;
   pid_t thepid;
@@ -354,3 +354,161 @@ pgp_key_t pgp_get_candidates (pgp_ring_t keyring, LIST * hints)
 
   return db;
 }
+
+/*
+ * The parsed listing of each keyring is kept for the whole session,
+ * so that looking up the keys of many recipients runs the (forking)
+ * list command only once instead of once per address. It's dropped
+ * as soon as the keyring files or the list command change.
+ */
+
+static struct pgp_keycache {
+  pgp_key_t keys;
+  char *command;
+  time_t mtime;
+  off_t size;
+} KeyCache[2];
+
+/* combined mtime and size of the keyring files that may be listed;
+ * -1 if we can't find any, or their paths don't fit, and therefore
+ * can't tell when to reload */
+static int pgp_keyring_stamp (pgp_ring_t keyring, time_t * mtime,
+                              off_t * size)
+{
+  static const char *pubring[] = { "pubring.kbx", "pubring.gpg",
+    "pubring.pgp", "pubring.pkr", NULL
+  };
+  static const char *secring[] = { "private-keys-v1.d", "secring.gpg",
+    "secring.pgp", "secring.skr", NULL
+  };
+  char dirs[2][_POSIX_PATH_MAX];
+  char path[_POSIX_PATH_MAX];
+  const char **f;
+  const char *env;
+  struct stat sb;
+  int found = 0;
+  int i;
+
+  if ((env = getenv ("GNUPGHOME")))
+    strfcpy (dirs[0], env, sizeof (dirs[0]));
+  else
+    snprintf (dirs[0], sizeof (dirs[0]), "%s/.gnupg", NONULL (Homedir));
+  if ((env = getenv ("PGPPATH")))
+    strfcpy (dirs[1], env, sizeof (dirs[1]));
+  else
+    snprintf (dirs[1], sizeof (dirs[1]), "%s/.pgp", NONULL (Homedir));
+
+  *mtime = 0;
+  *size = 0;
+  for (i = 0; i < 2; i++) {
+    for (f = keyring == PGP_SECRING ? secring : pubring; *f; f++) {
+      if (snprintf (path, sizeof (path), "%s/%s",
+                    dirs[i], *f) >= (int) sizeof (path))
+        return -1;
+      if (stat (path, &sb) == 0) {
+        *mtime = MAX (*mtime, sb.st_mtime);
+        *size += sb.st_size;
+        found = 1;
+      }
+    }
+  }
+
+  /* validities come from the trust database */
+  if (snprintf (path, sizeof (path), "%s/trustdb.gpg",
+                dirs[0]) >= (int) sizeof (path))
+    return -1;
+  if (found && stat (path, &sb) == 0)
+    *mtime = MAX (*mtime, sb.st_mtime);
+
+  return found ? 0 : -1;
+}
+
+/* mimic the list command's own selection: a hint matches a key ID
+ * or is a case-insensitive substring of a user ID */
+static int pgp_key_matches_hints (pgp_key_t k, LIST * hints)
+{
+  pgp_uid_t *a;
+  const char *h;
+  size_t hl, kl;
+
+  if (!hints)
+    return 1;
+
+  for (; hints; hints = hints->next) {
+    h = hints->data;
+    if (!str_ncasecmp (h, "0x", 2))
+      h += 2;
+    hl = str_len (h);
+    kl = str_len (k->keyid);
+    if (hl >= 8 && hl <= kl && !str_casecmp (k->keyid + kl - hl, h))
+      return 1;
+
+    for (a = k->address; a; a = a->next)
+      if (str_isstr (a->addr, hints->data))
+        return 1;
+  }
+
+  return 0;
+}
+
+static pgp_key_t pgp_copy_key (pgp_key_t k, pgp_key_t parent)
+{
+  pgp_key_t c = pgp_new_keyinfo ();
+
+  c->keyid = str_dup (k->keyid);
+  c->address = pgp_copy_uids (k->address, c);
+  c->flags = k->flags;
+  c->keylen = k->keylen;
+  c->gen_time = k->gen_time;
+  c->numalg = k->numalg;
+  c->algorithm = k->algorithm;
+  c->parent = parent;
+  c->fp_len = k->fp_len;
+  memcpy (c->fingerprint, k->fingerprint, sizeof (c->fingerprint));
+
+  return c;
+}
+
+pgp_key_t pgp_get_candidates (pgp_ring_t keyring, LIST * hints)
+{
+  struct pgp_keycache *cache = &KeyCache[keyring == PGP_SECRING];
+  const char *command = keyring == PGP_SECRING ? PgpListSecringCommand :
+    PgpListPubringCommand;
+  pgp_key_t db = NULL, *kend = &db;
+  pgp_key_t k, sk, mainkey;
+  time_t mtime;
+  off_t size;
+  int match;
+
+  if (pgp_keyring_stamp (keyring, &mtime, &size) == -1)
+    return pgp_list_keys (keyring, hints);
+
+  if (!cache->keys || cache->mtime != mtime || cache->size != size
+      || str_cmp (cache->command, command)) {
+    debug_print (2, ("(re)loading %s key cache\n",
+                     keyring == PGP_SECRING ? "secret" : "public"));
+    pgp_free_key (&cache->keys);
+    cache->keys = pgp_list_keys (keyring, NULL);
+    str_replace (&cache->command, command);
+    cache->mtime = mtime;
+    cache->size = size;
+  }
+
+  /* hand out copies of every key (with its subkeys) that matches */
+  for (k = cache->keys; k; k = sk) {
+    match = pgp_key_matches_hints (k, hints);
+    for (sk = k->next; sk && sk->parent == k; sk = sk->next)
+      match = match || pgp_key_matches_hints (sk, hints);
+    if (!match)
+      continue;
+
+    *kend = mainkey = pgp_copy_key (k, NULL);
+    kend = &mainkey->next;
+    for (sk = k->next; sk && sk->parent == k; sk = sk->next) {
+      *kend = pgp_copy_key (sk, mainkey);
+      kend = &(*kend)->next;
+    }
+  }
+
+  return db;
+}
@@ -17,6 +17,8 @@
 #include <ctype.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
+#include <dirent.h>
+#include <utime.h>
 
 #include "mutt.h"
 #include "ascii.h"
@@ -33,6 +35,7 @@
 #include "state.h"
 #include "attach.h"
 #include "lib.h"
+#include "md5.h"
 
 #include "lib/mem.h"
 #include "lib/intl.h"
@@ -169,13 +172,15 @@ static void qp_decode_line (char *dest, char *src, size_t * l, int last)
  * 
  * Just to make sure that I didn't make some off-by-one error
  * above, we just use STRING*2 for the target buffer's size.
+ * On top of that, decoded lines are collected until BUFO_SIZE bytes
+ * are pending so that conversion and output work on larger blocks.
  * 
  */
 
 void mutt_decode_quoted (STATE * s, long len, int istext, iconv_t cd)
 {
   char line[STRING];
-  char decline[2 * STRING];
+  char decline[BUFO_SIZE + 2 * STRING];
   size_t l = 0;
   size_t linelen;               /* number of input bytes in `line' */
   size_t l3;
@@ -214,85 +219,110 @@ void mutt_decode_quoted (STATE * s, long len, int istext, iconv_t cd)
       line[linelen] = 0;
     }
 
-    /* decode and do character set conversion */
+    /* decode and do character set conversion once enough lines piled up */
     qp_decode_line (decline + l, line, &l3, last);
     l += l3;
-    mutt_convert_to_state (cd, decline, &l, s);
+    if (l >= BUFO_SIZE)
+      mutt_convert_to_state (cd, decline, &l, s);
   }
 
+  mutt_convert_to_state (cd, decline, &l, s);
   mutt_convert_to_state (cd, 0, 0, s);
   state_reset_prefix (s);
 }
 
+/*
+ * Emit one decoded byte to bufi, turning CRLF into LF for text parts.
+ * For binary parts cr never gets set so bytes go straight through.
+ */
+#define B64_PUTC(c) do { \
+  if (cr && (c) != '\n') \
+    bufi[l++] = '\r'; \
+  cr = 0; \
+  if (istext && (c) == '\r') \
+    cr = 1; \
+  else \
+    bufi[l++] = (c); \
+} while (0)
+
+/*
+ * The input is read in blocks instead of per character via fgetc() and
+ * complete quadruples are decoded straight from that block; output is
+ * collected in bufi and only handed to mutt_convert_to_state() once
+ * that's almost full.
+ */
 void mutt_decode_base64 (STATE * s, long len, int istext, iconv_t cd)
 {
-  char buf[5];
-  int c1, c2, c3, c4, ch, cr = 0, i;
+  unsigned char bufin[BUFO_SIZE];
+  char buf[4];
+  int c1, c2, c3, c4, ch, cr = 0, i = 0, done = 0;
   char bufi[BUFI_SIZE];
-  size_t l = 0;
-
-  buf[4] = 0;
+  size_t l = 0, n, p;
 
   if (istext)
     state_set_prefix (s);
 
-  while (len > 0) {
-    for (i = 0; i < 4 && len > 0; len--) {
-      if ((ch = fgetc (s->fpin)) == EOF)
-        break;
-      if (ch >= 0 && ch < 128 && (base64val (ch) != -1 || ch == '='))
-        buf[i++] = ch;
-    }
-    if (i != 4) {
-      debug_print (2, ("didn't get a multiple of 4 chars.\n"));
+  while (len > 0 && !done) {
+    if ((n = fread (bufin, 1, MIN ((long) sizeof (bufin), len), s->fpin)) == 0)
       break;
-    }
-
-    c1 = base64val (buf[0]);
-    c2 = base64val (buf[1]);
-    ch = (c1 << 2) | (c2 >> 4);
-
-    if (cr && ch != '\n')
-      bufi[l++] = '\r';
-
-    cr = 0;
-
-    if (istext && ch == '\r')
-      cr = 1;
-    else
-      bufi[l++] = ch;
-
-    if (buf[2] == '=')
-      break;
-    c3 = base64val (buf[2]);
-    ch = ((c2 & 0xf) << 4) | (c3 >> 2);
-
-    if (cr && ch != '\n')
-      bufi[l++] = '\r';
+    len -= n;
+
+    for (p = 0; p < n; p++) {
+      /* fast path: four valid characters in a row at a quad boundary */
+      if (i == 0 && p + 4 <= n && bufin[p] < 128 && bufin[p + 1] < 128 &&
+          bufin[p + 2] < 128 && bufin[p + 3] < 128 &&
+          (c1 = base64val (bufin[p])) >= 0 &&
+          (c2 = base64val (bufin[p + 1])) >= 0 &&
+          (c3 = base64val (bufin[p + 2])) >= 0 &&
+          (c4 = base64val (bufin[p + 3])) >= 0) {
+        p += 3;
+        ch = (c1 << 2) | (c2 >> 4);
+        B64_PUTC (ch);
+        ch = ((c2 & 0xf) << 4) | (c3 >> 2);
+        B64_PUTC (ch);
+        ch = ((c3 & 0x3) << 6) | c4;
+        B64_PUTC (ch);
+        if (l + 8 >= sizeof (bufi))
+          mutt_convert_to_state (cd, bufi, &l, s);
+        continue;
+      }
 
-    cr = 0;
+      /* collect a quadruple across line breaks, padding and junk */
+      ch = bufin[p];
+      if (ch < 128 && (base64val (ch) != -1 || ch == '='))
+        buf[i++] = ch;
+      if (i < 4)
+        continue;
+      i = 0;
 
-    if (istext && ch == '\r')
-      cr = 1;
-    else
-      bufi[l++] = ch;
+      c1 = base64val (buf[0]);
+      c2 = base64val (buf[1]);
+      ch = (c1 << 2) | (c2 >> 4);
+      B64_PUTC (ch);
 
-    if (buf[3] == '=')
-      break;
-    c4 = base64val (buf[3]);
-    ch = ((c3 & 0x3) << 6) | c4;
+      if (buf[2] == '=') {
+        done = 1;
+        break;
+      }
+      c3 = base64val (buf[2]);
+      ch = ((c2 & 0xf) << 4) | (c3 >> 2);
+      B64_PUTC (ch);
 
-    if (cr && ch != '\n')
-      bufi[l++] = '\r';
-    cr = 0;
+      if (buf[3] == '=') {
+        done = 1;
+        break;
+      }
+      c4 = base64val (buf[3]);
+      ch = ((c3 & 0x3) << 6) | c4;
+      B64_PUTC (ch);
 
-    if (istext && ch == '\r')
-      cr = 1;
-    else
-      bufi[l++] = ch;
+      if (l + 8 >= sizeof (bufi))
+        mutt_convert_to_state (cd, bufi, &l, s);
+    }
+  }
 
-    if (l + 8 >= sizeof (bufi))
-      mutt_convert_to_state (cd, bufi, &l, s);
+  if (!done && i) {
+    debug_print (2, ("didn't get a multiple of 4 chars.\n"));
   }
 
   if (cr)
@@ -304,6 +334,8 @@ void mutt_decode_base64 (STATE * s, long len, int istext, iconv_t cd)
   state_reset_prefix (s);
 }
 
+#undef B64_PUTC
+
 unsigned char decode_byte (char ch)
 {
   if (ch == 96)
@@ -1077,6 +1109,128 @@ static int multipart_handler (BODY * a, STATE * s)
   return (rc);
 }
 
+/*
+ * The output of autoview commands may be kept in $autoview_cache, in
+ * files named after the MD5 digest of the command, the content type
+ * and its parameters, $charset and the part's content. Entries are
+ * touched when used and the least recently used ones are removed once
+ * there are more than $autoview_cache_size of them.
+ */
+
+static void autoview_cache_key (BODY * a, const char *command,
+                                const char *type, MD5_CTX * md5)
+{
+  PARAMETER *p;
+
+  MD5Init (md5);
+  MD5Update (md5, (unsigned char *) command, str_len (command) + 1);
+  MD5Update (md5, (unsigned char *) type, str_len (type) + 1);
+  for (p = a->parameter; p; p = p->next) {
+    MD5Update (md5, (unsigned char *) NONULL (p->attribute),
+               str_len (p->attribute) + 1);
+    MD5Update (md5, (unsigned char *) NONULL (p->value),
+               str_len (p->value) + 1);
+  }
+  MD5Update (md5, (unsigned char *) NONULL (Charset),
+             str_len (Charset) + 1);
+}
+
+/* -1 with path empty if the name doesn't fit */
+static int autoview_cache_path (char *path, size_t len, MD5_CTX * md5)
+{
+  unsigned char digest[16];
+  char hex[33];
+  int i;
+
+  MD5Final (digest, md5);
+  for (i = 0; i < 16; i++)
+    sprintf (hex + 2 * i, "%02x", digest[i]);
+  if (snprintf (path, len, "%s/%s", AutoViewCache, hex) >= (int) len) {
+    *path = '\0';
+    return (-1);
+  }
+  return (0);
+}
+
+/* copies len bytes and feeds them to the digest */
+static void autoview_copy_bytes (FILE * in, FILE * out, size_t len,
+                                 MD5_CTX * md5)
+{
+  char buf[2048];
+  size_t chunk;
+
+  while (len > 0) {
+    chunk = (len > sizeof (buf)) ? sizeof (buf) : len;
+    if ((chunk = fread (buf, 1, chunk, in)) < 1)
+      break;
+    MD5Update (md5, (unsigned char *) buf, chunk);
+    fwrite (buf, 1, chunk, out);
+    len -= chunk;
+  }
+}
+
+typedef struct autoview_cache_entry {
+  char *name;
+  time_t mtime;
+} autoview_cache_entry_t;
+
+static int autoview_cache_cmp (const void *a, const void *b)
+{
+  time_t ma = ((const autoview_cache_entry_t *) a)->mtime;
+  time_t mb = ((const autoview_cache_entry_t *) b)->mtime;
+
+  return ma < mb ? -1 : ma > mb ? 1 : 0;
+}
+
+/* removes the least recently used entries beyond $autoview_cache_size */
+static void autoview_cache_trim (void)
+{
+  autoview_cache_entry_t *entries = NULL;
+  char path[_POSIX_PATH_MAX];
+  struct dirent *de;
+  struct stat st;
+  DIR *dp;
+  int count = 0, max = 0, i;
+
+  if ((dp = opendir (AutoViewCache)) == NULL)
+    return;
+
+  while ((de = readdir (dp)) != NULL) {
+    /* skip ".", ".." and entries still being written */
+    if (strchr (de->d_name, '.'))
+      continue;
+    /* names that don't fit can't be ours */
+    if (snprintf (path, sizeof (path), "%s/%s", AutoViewCache,
+                  de->d_name) >= (int) sizeof (path) ||
+        stat (path, &st) == -1 || !S_ISREG (st.st_mode))
+      continue;
+    if (count == max) {
+      max += 64;
+      mem_realloc (&entries, max * sizeof (autoview_cache_entry_t));
+    }
+    entries[count].name = str_dup (de->d_name);
+    entries[count].mtime = st.st_mtime;
+    count++;
+  }
+  closedir (dp);
+
+  if (count > AutoViewCacheSize) {
+    qsort (entries, count, sizeof (autoview_cache_entry_t),
+           autoview_cache_cmp);
+    for (i = 0; i < count - (AutoViewCacheSize > 0 ? AutoViewCacheSize : 0);
+         i++) {
+      snprintf (path, sizeof (path), "%s/%s", AutoViewCache,
+                entries[i].name);
+      debug_print (2, ("expiring %s\n", path));
+      unlink (path);
+    }
+  }
+
+  for (i = 0; i < count; i++)
+    mem_free (&entries[i].name);
+  mem_free (&entries);
+}
+
 static int autoview_handler (BODY * a, STATE * s)
 {
   rfc1524_entry *entry = rfc1524_new_entry ();
@@ -1084,12 +1238,18 @@ static int autoview_handler (BODY * a, STATE * s)
   char type[STRING];
   char command[LONG_STRING];
   char tempfile[_POSIX_PATH_MAX] = "";
+  char cachefile[_POSIX_PATH_MAX] = "";
+  char cachetemp[_POSIX_PATH_MAX] = "";
   char *fname;
   FILE *fpin = NULL;
   FILE *fpout = NULL;
   FILE *fperr = NULL;
+  FILE *fpcache = NULL;
+  MD5_CTX md5;
   int piped = FALSE;
-  pid_t thepid;
+  int cached = FALSE;
+  int errors = FALSE;
+  pid_t thepid = -1;
   int rc = 0;
 
   snprintf (type, sizeof (type), "%s/%s", TYPE (a), a->subtype);
@@ -1111,7 +1271,6 @@ static int autoview_handler (BODY * a, STATE * s)
     if (s->flags & M_DISPLAY) {
       state_mark_attach (s);
       state_printf (s, _("[-- Autoview using %s --]\n"), command);
-      mutt_message (_("Invoking autoview command: %s"), command);
     }
 
     if ((fpin = safe_fopen (tempfile, "w+")) == NULL) {
@@ -1120,29 +1279,63 @@ static int autoview_handler (BODY * a, STATE * s)
       return (-1);
     }
 
-    mutt_copy_bytes (s->fpin, fpin, a->length);
+    if (AutoViewCache && *AutoViewCache) {
+      autoview_cache_key (a, entry->command, type, &md5);
+      autoview_copy_bytes (s->fpin, fpin, a->length, &md5);
+      if (autoview_cache_path (cachefile, sizeof (cachefile), &md5) == 0 &&
+          (fpout = fopen (cachefile, "r")) != NULL) {
+        debug_print (2, ("using %s\n", cachefile));
+        utime (cachefile, NULL);
+        cached = TRUE;
+      }
+    }
+    else
+      mutt_copy_bytes (s->fpin, fpin, a->length);
 
-    if (!piped) {
+    if (!piped)
       safe_fclose (&fpin);
-      thepid = mutt_create_filter (command, NULL, &fpout, &fperr);
-    }
     else {
       unlink (tempfile);
       fflush (fpin);
       rewind (fpin);
-      thepid = mutt_create_filter_fd (command, NULL, &fpout, &fperr,
-                                      fileno (fpin), -1, -1);
     }
 
-    if (thepid < 0) {
-      mutt_perror (_("Can't create filter"));
+    if (!cached) {
+      if (s->flags & M_DISPLAY)
+        mutt_message (_("Invoking autoview command: %s"), command);
 
-      if (s->flags & M_DISPLAY) {
-        state_mark_attach (s);
-        state_printf (s, _("[-- Can't run %s. --]\n"), command);
+      if (!piped)
+        thepid = mutt_create_filter (command, NULL, &fpout, &fperr);
+      else
+        thepid = mutt_create_filter_fd (command, NULL, &fpout, &fperr,
+                                        fileno (fpin), -1, -1);
+
+      if (thepid < 0) {
+        mutt_perror (_("Can't create filter"));
+
+        if (s->flags & M_DISPLAY) {
+          state_mark_attach (s);
+          state_printf (s, _("[-- Can't run %s. --]\n"), command);
+        }
+        rc = -1;
+        goto bail;
+      }
+
+      /* collect the output in the cache first, then show it from there */
+      if (*cachefile) {
+        /* a truncated name might be another entry's */
+        if (snprintf (cachetemp, sizeof (cachetemp), "%s.%d", cachefile,
+                      (int) getpid ()) < (int) sizeof (cachetemp) &&
+            (fpcache = safe_fopen (cachetemp, "w+")) != NULL) {
+          mutt_copy_stream (fpout, fpcache);
+          safe_fclose (&fpout);
+          fflush (fpcache);
+          rewind (fpcache);
+          fpout = fpcache;
+        }
+        else
+          *cachetemp = '\0';
       }
-      rc = -1;
-      goto bail;
     }
 
     if (s->prefix) {
@@ -1151,7 +1344,8 @@ static int autoview_handler (BODY * a, STATE * s)
         state_puts (buffer, s);
       }
       /* check for data on stderr */
-      if (fgets (buffer, sizeof (buffer), fperr)) {
+      if (fperr && fgets (buffer, sizeof (buffer), fperr)) {
+        errors = TRUE;
         if (s->flags & M_DISPLAY) {
           state_mark_attach (s);
           state_printf (s, _("[-- Autoview stderr of %s --]\n"), command);
@@ -1168,7 +1362,8 @@ static int autoview_handler (BODY * a, STATE * s)
     else {
       mutt_copy_stream (fpout, s->fpout);
       /* Check for stderr messages */
-      if (fgets (buffer, sizeof (buffer), fperr)) {
+      if (fperr && fgets (buffer, sizeof (buffer), fperr)) {
+        errors = TRUE;
         if (s->flags & M_DISPLAY) {
           state_mark_attach (s);
           state_printf (s, _("[-- Autoview stderr of %s --]\n"), command);
@@ -1183,7 +1378,15 @@ static int autoview_handler (BODY * a, STATE * s)
     safe_fclose (&fpout);
     safe_fclose (&fperr);
 
-    mutt_wait_filter (thepid);
+    if (!cached && mutt_wait_filter (thepid) != 0)
+      errors = TRUE;
+    if (*cachetemp) {
+      /* only keep the output of commands which ran cleanly */
+      if (!errors && rc == 0 && rename (cachetemp, cachefile) == 0)
+        autoview_cache_trim ();
+      else
+        unlink (cachetemp);
+    }
     if (piped)
       safe_fclose (&fpin);
     else
@@ -1325,8 +1528,7 @@ void mutt_decode_attachment (BODY * b, STATE * s)
     break;
   }
 
-  if (cd != (iconv_t) (-1))
-    iconv_close (cd);
+  mutt_iconv_close (cd);
 }
 
 int mutt_body_handler (BODY * b, STATE * s)
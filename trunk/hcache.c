@@ -14,7 +14,7 @@
 
 #ifdef USE_HCACHE
 
-#define MUTTNG_HCACHE_ID        "0x004"
+#define MUTTNG_HCACHE_ID        "0x006"
 
 # if HAVE_INTTYPES_H
 #  include <inttypes.h>
@@ -47,6 +47,7 @@
 #include "mx.h"
 #include "lib.h"
 #include "md5.h"
+#include "hcache.h"
 
 #include "lib/mem.h"
 #include "lib/debug.h"
@@ -170,6 +171,14 @@ static void restore_char (char **c, const unsigned char *d, int *off)
   *off += size;
 }
 
+static void skip_char (const unsigned char *d, int *off)
+{
+  unsigned int size;
+
+  restore_int (&size, d, off);
+  *off += size;
+}
+
 static unsigned char *dump_address (ADDRESS * a, unsigned char *d, int *off)
 {
   unsigned int counter = 0;
@@ -208,6 +217,20 @@ static void restore_address (ADDRESS ** a, const unsigned char *d, int *off)
   *a = NULL;
 }
 
+static void skip_address (const unsigned char *d, int *off)
+{
+  unsigned int counter;
+
+  restore_int (&counter, d, off);
+
+  while (counter) {
+    skip_char (d, off);
+    skip_char (d, off);
+    *off += sizeof (int);
+    counter--;
+  }
+}
+
 static unsigned char *dump_list (LIST * l, unsigned char *d, int *off)
 {
   unsigned int counter = 0;
@@ -242,6 +265,18 @@ static void restore_list (LIST ** l, const unsigned char *d, int *off)
   *l = NULL;
 }
 
+static void skip_list (const unsigned char *d, int *off)
+{
+  unsigned int counter;
+
+  restore_int (&counter, d, off);
+
+  while (counter) {
+    skip_char (d, off);
+    counter--;
+  }
+}
+
 #if 0
 static unsigned char *dump_buffer (BUFFER * b, unsigned char *d, int *off)
 {
@@ -431,6 +466,41 @@ static void restore_envelope (ENVELOPE * e, const unsigned char *d, int *off)
   restore_list (&e->userhdrs, d, off);
 }
 
+/*
+ * M_HCACHE_SUMMARY: when a mailbox is only opened to count messages
+ * (see M_COUNT) nothing but flags, size and the IDs used for superseding
+ * is ever looked at, so don't build addresses, subjects and references
+ * which would be freed right away again
+ */
+static void restore_envelope_summary (ENVELOPE * e, const unsigned char *d,
+                                      int *off)
+{
+  int i;
+
+  /* return_path, from, to, cc, bcc, sender, reply_to, mail_followup_to */
+  for (i = 0; i < 8; i++)
+    skip_address (d, off);
+
+  skip_char (d, off);           /* subject */
+  *off += sizeof (int);         /* real_subj */
+  restore_char (&e->message_id, d, off);
+  restore_char (&e->supersedes, d, off);
+  skip_char (d, off);           /* date */
+  skip_char (d, off);           /* x_label */
+  skip_char (d, off);           /* list_post */
+
+#ifdef USE_NNTP
+  skip_char (d, off);           /* newsgroups */
+  skip_char (d, off);           /* xref */
+  skip_char (d, off);           /* followup_to */
+  skip_char (d, off);           /* x_comment_to */
+#endif
+
+  skip_list (d, off);           /* references */
+  skip_list (d, off);           /* in_reply_to */
+  skip_list (d, off);           /* userhdrs */
+}
+
 static
 unsigned int crc32 (unsigned int crc, unsigned char const *p, size_t len)
 {
@@ -571,7 +641,7 @@ static void *mutt_hcache_dump (void *_db, HEADER * h, int *off,
   return d;
 }
 
-HEADER *mutt_hcache_restore (const unsigned char *d, HEADER ** oh)
+HEADER *mutt_hcache_restore (const unsigned char *d, HEADER ** oh, int flags)
 {
   int off = 0;
   HEADER *h = mutt_new_header ();
@@ -584,9 +654,15 @@ HEADER *mutt_hcache_restore (const unsigned char *d, HEADER ** oh)
 
   memcpy (h, d + off, sizeof (HEADER));
   off += sizeof (HEADER);
+  h->score_cache = NULL;
+  h->score_cache_len = 0;
+  h->pair_gen = 0;
 
   h->env = mutt_new_envelope ();
-  restore_envelope (h->env, d, &off);
+  if (flags & M_HCACHE_SUMMARY)
+    restore_envelope_summary (h->env, d, &off);
+  else
+    restore_envelope (h->env, d, &off);
 
   h->content = mutt_new_body ();
   restore_body (h->content, d, &off);
@@ -12,9 +12,12 @@
 #define _MUTT_HCACHE_H
 
 #if USE_HCACHE
+/* flags for mutt_hcache_restore() */
+#define M_HCACHE_SUMMARY        (1<<0)  /* envelope: only IDs, see M_COUNT */
+
 void *mutt_hcache_open(const char *path, const char *folder);
 void mutt_hcache_close(void *db);
-HEADER *mutt_hcache_restore(const unsigned char *d, HEADER **oh);
+HEADER *mutt_hcache_restore(const unsigned char *d, HEADER **oh, int flags);
 void *mutt_hcache_fetch(void *db, const char *filename,
                         size_t (*keylen)(const char *fn));
 int mutt_hcache_store(void *db, const char *filename, HEADER *h,
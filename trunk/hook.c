@@ -33,18 +33,150 @@
 
 #define ERROR_STOP      0
 
+/*
+ * Hooks with the same pattern share one compiled pattern, which is
+ * evaluated at most once per message as long as no hook command was
+ * run in between (commands may change what patterns match, e.g. by
+ * subscribing to lists).
+ */
+typedef struct hook_pattern {
+  char *key;                    /* compile flags and pattern */
+  pattern_t *pattern;
+  int refs;
+  unsigned int stamp;           /* evaluation result is valid for */
+  int result;
+} HOOK_PATTERN;
+
 typedef struct hook {
   int type;                     /* hook type */
   rx_t rx;                      /* regular expression */
   char *command;                /* filename, command or pattern to execute */
-  pattern_t *pattern;           /* used for fcc,save,send-hook */
+  HOOK_PATTERN *pattern;        /* used for fcc,save,send-hook */
   struct hook *next;
 } HOOK;
 
 static HOOK *Hooks = NULL;
 
+/* hooks are only ever looked up by a single type, so they are also
+ * indexed in definition order by each type bit they have; hooks
+ * like fcc-save-hook appear in several of these */
+#define HOOK_TYPES      15
+
+static list2_t *HookTypes[HOOK_TYPES];
+
+static HASH *HookPatterns = NULL;
+static unsigned int HookStamp = 0;
+
 static int current_hook_type = 0;
 
+static int hook_index (int type)
+{
+  int i;
+
+  for (i = 0; i < HOOK_TYPES - 1 && !(type & (1 << i)); i++);
+  return i;
+}
+
+static void hook_index_add (HOOK * h)
+{
+  int i;
+
+  for (i = 0; i < HOOK_TYPES; i++)
+    if (h->type & (1 << i))
+      list_push_back (&HookTypes[i], h);
+}
+
+static void hook_index_remove (HOOK * h)
+{
+  list2_t *l;
+  size_t i, j;
+
+  for (i = 0; i < HOOK_TYPES; i++) {
+    if (!(h->type & (1 << i)) || !(l = HookTypes[i]))
+      continue;
+    for (j = 0; j < l->length && l->data[j] != h; j++);
+    if (j < l->length) {
+      memmove (&l->data[j], &l->data[j + 1],
+               (l->length - j - 1) * sizeof (void *));
+      l->length--;
+    }
+  }
+}
+
+/* the n-th hook of the given type or NULL; hooks may be added while
+ * walking them */
+static HOOK *hook_get (int type, size_t n)
+{
+  list2_t *l = HookTypes[hook_index (type)];
+
+  return (l && n < l->length) ? (HOOK *) l->data[n] : NULL;
+}
+
+static HOOK_PATTERN *hook_pattern_get (const char *s, int flags,
+                                       BUFFER * err)
+{
+  HOOK_PATTERN *hp;
+  pattern_t *pat;
+  char *key;
+  size_t len = str_len (s) + 3;
+
+  key = mem_malloc (len);
+  snprintf (key, len, "%d:%s", flags ? 1 : 0, NONULL (s));
+
+  if (!HookPatterns)
+    HookPatterns = hash_create (64);
+  else if ((hp = hash_find (HookPatterns, key))) {
+    mem_free (&key);
+    hp->refs++;
+    return hp;
+  }
+
+  if ((pat = mutt_pattern_comp ((char *) s, flags, err)) == NULL) {
+    mem_free (&key);
+    return NULL;
+  }
+
+  hp = mem_calloc (1, sizeof (HOOK_PATTERN));
+  hp->key = key;
+  hp->pattern = pat;
+  hp->refs = 1;
+  if (HookPatterns->curnelem > 2 * HookPatterns->nelem)
+    HookPatterns = hash_resize (HookPatterns, 4 * HookPatterns->nelem);
+  hash_insert (HookPatterns, hp->key, hp, 0);
+  return hp;
+}
+
+static void hook_pattern_free (HOOK_PATTERN ** hp)
+{
+  if (!*hp)
+    return;
+  if (--(*hp)->refs <= 0) {
+    hash_delete (HookPatterns, (*hp)->key, *hp, NULL);
+    mutt_pattern_free (&(*hp)->pattern);
+    mem_free (&(*hp)->key);
+    mem_free (hp);
+  }
+  *hp = NULL;
+}
+
+static int hook_pattern_exec (HOOK_PATTERN * hp, CONTEXT * ctx,
+                              HEADER * hdr)
+{
+  if (hp->stamp != HookStamp) {
+    hp->result = mutt_pattern_exec (hp->pattern, 0, ctx, hdr) > 0;
+    hp->stamp = HookStamp;
+  }
+  return hp->result;
+}
+
+/* invalidates all results of hook_pattern_exec() */
+static void hook_pattern_reset (void)
+{
+  /* 0 is the stamp of a pattern never evaluated */
+  if (++HookStamp == 0)
+    HookStamp = 1;
+}
+
 int mutt_parse_hook (BUFFER * buf, BUFFER * s, unsigned long data,
                      BUFFER * err)
 {
@@ -52,7 +184,7 @@ int mutt_parse_hook (BUFFER * buf, BUFFER * s, unsigned long data,
   BUFFER command, pattern;
   int rc, not = 0;
   regex_t *rx = NULL;
-  pattern_t *pat = NULL;
+  HOOK_PATTERN *pat = NULL;
   char path[_POSIX_PATH_MAX];
 
   memset (&pattern, 0, sizeof (pattern));
@@ -157,9 +289,9 @@ int mutt_parse_hook (BUFFER * buf, BUFFER * s, unsigned long data,
       (M_SENDHOOK | M_SEND2HOOK | M_SAVEHOOK | M_FCCHOOK | M_MESSAGEHOOK |
        M_REPLYHOOK)) {
     if ((pat =
-         mutt_pattern_comp (pattern.data,
-                            (data & (M_SENDHOOK | M_SEND2HOOK | M_FCCHOOK)) ?
-                            0 : M_FULL_MSG, err)) == NULL)
+         hook_pattern_get (pattern.data,
+                           (data & (M_SENDHOOK | M_SEND2HOOK | M_FCCHOOK)) ?
+                           0 : M_FULL_MSG, err)) == NULL)
       goto error;
   }
   else {
@@ -195,6 +327,7 @@ int mutt_parse_hook (BUFFER * buf, BUFFER * s, unsigned long data,
   ptr->rx.pattern = pattern.data;
   ptr->rx.rx = rx;
   ptr->rx.not = not;
+  hook_index_add (ptr);
   return 0;
 
 error:
@@ -205,12 +338,13 @@ error:
 
 static void delete_hook (HOOK * h)
 {
+  hook_index_remove (h);
   mem_free (&h->command);
   mem_free (&h->rx.pattern);
   if (h->rx.rx) {
     regfree (h->rx.rx);
   }
-  mutt_pattern_free (&h->pattern);
+  hook_pattern_free (&h->pattern);
   mem_free (&h);
 }
 
@@ -273,16 +407,17 @@ int mutt_parse_unhook (BUFFER * buf, BUFFER * s, unsigned long data,
 
 void mutt_folder_hook (char *path)
 {
-  HOOK *tmp = Hooks;
+  HOOK *tmp;
   BUFFER err, token;
   char buf[STRING];
+  size_t n;
 
   current_hook_type = M_FOLDERHOOK;
 
   err.data = buf;
   err.dsize = sizeof (buf);
   memset (&token, 0, sizeof (token));
-  for (; tmp; tmp = tmp->next) {
+  for (n = 0; (tmp = hook_get (M_FOLDERHOOK, n)); n++) {
     if (!tmp->command)
       continue;
 
@@ -307,9 +442,10 @@ void mutt_folder_hook (char *path)
 
 char *mutt_find_hook (int type, const char *pat)
 {
-  HOOK *tmp = Hooks;
+  HOOK *tmp;
+  size_t n;
 
-  for (; tmp; tmp = tmp->next)
+  for (n = 0; (tmp = hook_get (type, n)); n++)
     if (tmp->type & type) {
       if (regexec (tmp->rx.rx, pat, 0, NULL, 0) == 0)
         return (tmp->command);
@@ -322,18 +458,21 @@ void mutt_message_hook (CONTEXT * ctx, HEADER * hdr, int type)
   BUFFER err, token;
   HOOK *hook;
   char buf[STRING];
+  size_t n;
 
   current_hook_type = type;
 
   err.data = buf;
   err.dsize = sizeof (buf);
   memset (&token, 0, sizeof (token));
-  for (hook = Hooks; hook; hook = hook->next) {
+  hook_pattern_reset ();
+  for (n = 0; (hook = hook_get (type, n)); n++) {
     if (!hook->command)
       continue;
 
     if (hook->type & type)
-      if ((mutt_pattern_exec (hook->pattern, 0, ctx, hdr) > 0) ^ hook->rx.not)
+      if (hook_pattern_exec (hook->pattern, ctx, hdr) ^ hook->rx.not) {
+        hook_pattern_reset ();
         if (mutt_parse_rc_line (hook->command, &token, &err) != 0) {
           mutt_error ("%s", err.data);
           mutt_sleep (1);
@@ -343,6 +482,7 @@ void mutt_message_hook (CONTEXT * ctx, HEADER * hdr, int type)
             return;
           }
         }
+      }
   }
   mem_free (&token.data);
   current_hook_type = 0;
@@ -353,14 +493,16 @@ mutt_addr_hook (char *path, size_t pathlen, int type, CONTEXT * ctx,
                 HEADER * hdr)
 {
   HOOK *hook;
+  size_t n;
 
   /* determine if a matching hook exists */
-  for (hook = Hooks; hook; hook = hook->next) {
+  hook_pattern_reset ();
+  for (n = 0; (hook = hook_get (type, n)); n++) {
     if (!hook->command)
       continue;
 
     if (hook->type & type)
-      if ((mutt_pattern_exec (hook->pattern, 0, ctx, hdr) > 0) ^ hook->rx.not) {
+      if (hook_pattern_exec (hook->pattern, ctx, hdr) ^ hook->rx.not) {
         mutt_make_string (path, pathlen, hook->command, ctx, hdr);
         return 0;
       }
@@ -418,9 +560,10 @@ void mutt_select_fcc (char *path, size_t pathlen, HEADER * hdr)
 
 static char *_mutt_string_hook (const char *match, int hook)
 {
-  HOOK *tmp = Hooks;
+  HOOK *tmp;
+  size_t n;
 
-  for (; tmp; tmp = tmp->next) {
+  for (n = 0; (tmp = hook_get (hook, n)); n++) {
     if ((tmp->type & hook) && ((match &&
                                 regexec (tmp->rx.rx, match, 0, NULL,
                                          0) == 0) ^ tmp->rx.not))
@@ -451,12 +594,13 @@ void mutt_account_hook (const char *url)
   BUFFER token;
   BUFFER err;
   char buf[STRING];
+  size_t n;
 
   err.data = buf;
   err.dsize = sizeof (buf);
   memset (&token, 0, sizeof (token));
 
-  for (hook = Hooks; hook; hook = hook->next) {
+  for (n = 0; (hook = hook_get (M_ACCOUNTHOOK, n)); n++) {
     if (!(hook->command && (hook->type & M_ACCOUNTHOOK)))
       continue;
 
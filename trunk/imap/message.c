@@ -153,7 +153,8 @@ int imap_read_headers (IMAP_DATA * idata, int msgbegin, int msgend)
           (unsigned long *) mutt_hcache_fetch (hc, uid_buf, &imap_hcache_keylen);
 
         if (uid_validity != NULL && *uid_validity == idata->uid_validity) {
-          ctx->hdrs[msgno] = mutt_hcache_restore((unsigned char *) uid_validity, 0);
+          ctx->hdrs[msgno] = mutt_hcache_restore((unsigned char *) uid_validity, 0,
+                                                 ctx->counting ? M_HCACHE_SUMMARY : 0);
           ctx->hdrs[msgno]->index = h.sid - 1;
           if (h.sid != ctx->msgcount + 1)
             debug_print (1, ("imap_read_headers: msgcount and sequence ID are inconsistent!"));
@@ -905,6 +905,7 @@ static int parse_unignore (BUFFER * buf, BUFFER * s, unsigned long data,
     remove_from_list (&Ignore, buf->data);
   }
   while (MoreArgs (s));
+  mutt_ignore_changed ();
 
   return 0;
 }
@@ -918,6 +919,7 @@ static int parse_ignore (BUFFER * buf, BUFFER * s, unsigned long data,
     add_to_list (&Ignore, buf->data);
   }
   while (MoreArgs (s));
+  mutt_ignore_changed ();
 
   return 0;
 }
@@ -1386,29 +1388,30 @@ static int parse_unalias (BUFFER * buf, BUFFER * s, unsigned long data,
           tmp->del = 1;
         set_option (OPTFORCEREDRAWINDEX);
       }
-      else
+      else {
+        for (tmp = Aliases; tmp; tmp = tmp->next)
+          mutt_alias_unindex (tmp);
         mutt_free_alias (&Aliases);
+      }
       break;
     }
-    else
-      for (tmp = Aliases; tmp; tmp = tmp->next) {
-        if (str_casecmp (buf->data, tmp->name) == 0) {
-          if (CurrentMenu == MENU_ALIAS) {
-            tmp->del = 1;
-            set_option (OPTFORCEREDRAWINDEX);
-            break;
-          }
-
-          if (last)
-            last->next = tmp->next;
-          else
-            Aliases = tmp->next;
-          tmp->next = NULL;
-          mutt_free_alias (&tmp);
-          break;
+    else if ((tmp = mutt_alias_find (buf->data))) {
+      if (CurrentMenu == MENU_ALIAS) {
+        tmp->del = 1;
+        set_option (OPTFORCEREDRAWINDEX);
+      }
+      else {
+        if (tmp == Aliases)
+          Aliases = tmp->next;
+        else {
+          for (last = Aliases; last->next != tmp; last = last->next);
+          last->next = tmp->next;
         }
-        last = tmp;
+        mutt_alias_unindex (tmp);
+        tmp->next = NULL;
+        mutt_free_alias (&tmp);
       }
+    }
   }
   while (MoreArgs (s));
   return 0;
@@ -1417,9 +1420,9 @@ static int parse_unalias (BUFFER * buf, BUFFER * s, unsigned long data,
 static int parse_alias (BUFFER * buf, BUFFER * s, unsigned long data,
                         BUFFER * err)
 {
-  ALIAS *tmp = Aliases;
-  ALIAS *last = NULL;
+  ALIAS *tmp;
   char *estr = NULL;
+  int bad_idn;
 
   if (!MoreArgs (s)) {
     strfcpy (err->data, _("alias: no address"), err->dsize);
@@ -1431,13 +1434,7 @@ static int parse_alias (BUFFER * buf, BUFFER * s, unsigned long data,
   debug_print (2, ("first token is '%s'.\n", buf->data));
 
   /* check to see if an alias with this name already exists */
-  for (; tmp; tmp = tmp->next) {
-    if (!str_casecmp (tmp->name, buf->data))
-      break;
-    last = tmp;
-  }
-
-  if (!tmp) {
+  if (!(tmp = mutt_alias_find (buf->data))) {
     /* create a new alias */
     tmp = (ALIAS *) mem_calloc (1, sizeof (ALIAS));
     tmp->self = tmp;
@@ -1448,6 +1445,7 @@ static int parse_alias (BUFFER * buf, BUFFER * s, unsigned long data,
   }
   else {
     /* override the previous value */
+    mutt_alias_unindex (tmp);
     rfc822_free_address (&tmp->addr);
     if (CurrentMenu == MENU_ALIAS)
       set_option (OPTFORCEREDRAWINDEX);
@@ -1457,11 +1455,12 @@ static int parse_alias (BUFFER * buf, BUFFER * s, unsigned long data,
                       M_TOKEN_QUOTE | M_TOKEN_SPACE | M_TOKEN_SEMICOLON);
   debug_print (2, ("second token is '%s'.\n", buf->data));
   tmp->addr = mutt_parse_adrlist (tmp->addr, buf->data);
-  if (last)
-    last->next = tmp;
+  bad_idn = mutt_addrlist_to_idna (tmp->addr, &estr);
+  if (tmp->seq)
+    mutt_alias_index (tmp);
   else
-    Aliases = tmp;
-  if (mutt_addrlist_to_idna (tmp->addr, &estr)) {
+    mutt_alias_append (tmp);
+  if (bad_idn) {
     snprintf (err->data, err->dsize,
               _("Warning: Bad IDN '%s' in alias '%s'.\n"), estr, tmp->name);
     return -1;
@@ -339,6 +339,24 @@ struct option_t MuttVars[] = {
    ** unset, you must first use the ``tag-prefix'' function (default: "\fT;\fP") to
    ** make the next function apply to all tagged messages.
    */
+  {"autoview_cache", DT_PATH, R_NONE, UL &AutoViewCache, "" },
+  /*
+   ** .pp
+   ** If \fIset\fP, this names a directory in which the output of
+   ** ``auto_view'' commands is kept, so that a part which is displayed
+   ** again with the same command and content type parameters is taken
+   ** from there instead of running the command again. Only output of
+   ** commands that succeeded without printing anything to standard
+   ** error is kept.
+   ** .pp
+   ** Also see ``$$autoview_cache_size''.
+   */
+  {"autoview_cache_size", DT_NUM, R_NONE, UL &AutoViewCacheSize, "100" },
+  /*
+   ** .pp
+   ** The maximum number of entries kept in ``$$autoview_cache''. When
+   ** it is exceeded, the least recently used entries are removed.
+   */
   {"beep", DT_BOOL, R_NONE, OPTBEEP, "yes" },
   /*
    ** .pp
@@ -8,14 +8,23 @@
 #include "config.h"
 #endif
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "rx.h"
 
 #include "mem.h"
 #include "str.h"
 
+/* bumped whenever an expression is compiled or freed, which is the
+ * only way lists of them can change */
+static unsigned int RxGeneration = 0;
+
 rx_t *rx_compile (const char *s, int flags) {
   rx_t *pp = mem_calloc (1, sizeof (rx_t));
 
+  RxGeneration++;
+
   pp->pattern = str_dup (s);
   pp->rx = mem_calloc (1, sizeof (regex_t));
   if (REGCOMP(pp->rx, NONULL (s), flags) != 0)
@@ -25,6 +34,7 @@ rx_t *rx_compile (const char *s, int flags) {
 }
 
 void rx_free (rx_t** p) {
+  RxGeneration++;
   mem_free(&(*p)->pattern);
   regfree ((*p)->rx);
   mem_free(&(*p)->rx);
@@ -35,14 +45,348 @@ int rx_compare (const rx_t* r1, const rx_t* r2) {
   return (str_cmp (r1->pattern, r2->pattern));
 }
 
+/*
+ * Matching one string against a list of expressions: most expressions
+ * can only match if the string contains some literal, so they are
+ * only tried if it does. The literals of all expressions of a list
+ * are searched for at once with an Aho-Corasick automaton ignoring
+ * ASCII case, which serves both REG_ICASE and case sensitive
+ * expressions. Automatons are kept for the last few lists used and
+ * rebuilt when expressions were compiled or freed since.
+ */
+
+#define RX_MULTI_MIN    4       /* shorter lists are just walked */
+#define RX_MULTI_SLOTS  16
+
+typedef struct rx_multi_t {
+  const list2_t* list;
+  unsigned int generation;
+  unsigned char class[256];     /* byte -> input class, 0 for others */
+  int nclass;
+  int nstate;
+  int* next;                    /* nstate * nclass transitions */
+  int* first;                   /* first expression ending in state or -1 */
+  int* dict;                    /* next state along the failure links
+                                 * with expressions ending in it or -1 */
+  int* chain;                   /* next expression with the same end */
+  int* always;                  /* expressions without literal */
+  int nalways;
+  unsigned int* seen;           /* candidate stamp per expression */
+  unsigned int stamp;
+  int* cand;
+} rx_multi_t;
+
+static rx_multi_t* RxMulti[RX_MULTI_SLOTS];
+static int RxMultiNext = 0;
+
+#define RX_LOWER(c) (((c) >= 'A' && (c) <= 'Z') ? (c) - 'A' + 'a' : (c))
+
+/* skips a bracket expression starting at p, returns its end */
+static const char* rx_skip_bracket (const char* p) {
+  p++;
+  if (*p == '^')
+    p++;
+  if (*p == ']')
+    p++;
+  for (; *p && *p != ']'; p++) {
+    if (*p == '[' && (p[1] == ':' || p[1] == '.' || p[1] == '=')) {
+      char c = p[1];
+
+      for (p += 2; *p && !(*p == c && p[1] == ']'); p++);
+      if (!*p)
+        break;
+      p++;
+    }
+  }
+  return (*p ? p : p - 1);
+}
+
+/* skips a (...) group starting at p, returns its end */
+static const char* rx_skip_group (const char* p) {
+  int depth = 0;
+
+  for (; *p; p++) {
+    if (*p == '\\' && p[1])
+      p++;
+    else if (*p == '[')
+      p = rx_skip_bracket (p);
+    else if (*p == '(')
+      depth++;
+    else if (*p == ')' && --depth == 0)
+      break;
+  }
+  return (*p ? p : p - 1);
+}
+
+/*
+ * Finds the longest run of characters every match of the extended
+ * expression must contain, lowercased; only ASCII is considered and
+ * anything not understood ends a run. Returns its length, 0 if there
+ * is none.
+ */
+static size_t rx_literal (const char* p, char* buf, size_t buflen) {
+  char run[STRING];
+  size_t len = 0, best = 0;
+  int c, literal;
+
+  for (; *p; p++) {
+    literal = 0;
+    c = 0;
+
+    switch (*p) {
+    case '|':
+      /* an alternative: no literal is mandatory */
+      return (0);
+    case '(':
+      p = rx_skip_group (p);
+      break;
+    case '[':
+      p = rx_skip_bracket (p);
+      break;
+    case '.':
+    case '^':
+    case '$':
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+    case ')':
+      break;
+    case '\\':
+      if (!p[1])
+        return (0);
+      c = (unsigned char) *++p;
+      /* escaped letters and digits are classes, anchors or back
+       * references, and so are a few punctuation characters */
+      literal = !((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                  (c >= '0' && c <= '9') || c >= 0x80 ||
+                  strchr ("<>`'", c));
+      break;
+    default:
+      c = (unsigned char) *p;
+      literal = (c < 0x80);
+      break;
+    }
+
+    /* an optional atom ends the run without being part of it */
+    if (p[1] == '*' || p[1] == '?' || p[1] == '{')
+      literal = 0;
+    else if (literal && len < sizeof (run))
+      run[len++] = RX_LOWER (c);
+    else
+      literal = 0;
+
+    /* a repeated atom may be followed by anything */
+    if (!literal || p[1] == '+') {
+      if (len > best && len < buflen) {
+        memcpy (buf, run, len);
+        best = len;
+      }
+      len = 0;
+    }
+
+    /* skip quantifiers */
+    while (p[1] == '*' || p[1] == '+' || p[1] == '?' || p[1] == '{') {
+      if (*++p == '{')
+        while (p[1] && *p != '}')
+          p++;
+    }
+  }
+
+  if (len > best && len < buflen) {
+    memcpy (buf, run, len);
+    best = len;
+  }
+  if (best)
+    buf[best] = '\0';
+  return (best);
+}
+
+static void rx_multi_free (rx_multi_t** m) {
+  if (!*m)
+    return;
+  mem_free (&(*m)->next);
+  mem_free (&(*m)->first);
+  mem_free (&(*m)->dict);
+  mem_free (&(*m)->chain);
+  mem_free (&(*m)->always);
+  mem_free (&(*m)->seen);
+  mem_free (&(*m)->cand);
+  mem_free (m);
+}
+
+static rx_multi_t* rx_multi_build (const list2_t* l) {
+  rx_multi_t* m = mem_calloc (1, sizeof (rx_multi_t));
+  char** lits = mem_calloc (l->length, sizeof (char*));
+  char buf[STRING];
+  int* go;                      /* trie, nstate * nclass, -1 if absent */
+  int* fail;
+  int* queue;
+  int i, j, k, st, maxstate = 1, head, tail;
+  char* q;
+
+  m->list = l;
+  m->generation = RxGeneration;
+  m->nclass = 1;
+
+  /* collect literals and the input classes they need */
+  for (i = 0; i < l->length; i++) {
+    if (rx_literal (((rx_t*) l->data[i])->pattern, buf, sizeof (buf)) > 0) {
+      lits[i] = str_dup (buf);
+      maxstate += str_len (buf);
+      for (q = buf; *q; q++) {
+        k = (unsigned char) *q;
+        if (!m->class[k]) {
+          m->class[k] = m->nclass++;
+          if (k >= 'a' && k <= 'z')
+            m->class[k - 'a' + 'A'] = m->class[k];
+        }
+      }
+    }
+  }
+
+  go = mem_malloc (maxstate * m->nclass * sizeof (int));
+  memset (go, -1, maxstate * m->nclass * sizeof (int));
+  m->first = mem_malloc (maxstate * sizeof (int));
+  m->dict = mem_malloc (maxstate * sizeof (int));
+  m->chain = mem_malloc (l->length * sizeof (int));
+  m->always = mem_malloc (l->length * sizeof (int));
+  m->seen = mem_calloc (l->length, sizeof (unsigned int));
+  m->cand = mem_malloc (l->length * sizeof (int));
+  m->first[0] = -1;
+  m->nstate = 1;
+
+  /* the trie; expressions are chained in reverse so that each chain
+   * ends up in list order */
+  for (i = l->length - 1; i >= 0; i--) {
+    if (!lits[i]) {
+      m->chain[i] = -1;
+      continue;
+    }
+    for (st = 0, q = lits[i]; *q; q++) {
+      k = m->class[(unsigned char) *q];
+      if (go[st * m->nclass + k] < 0) {
+        go[st * m->nclass + k] = m->nstate;
+        m->first[m->nstate++] = -1;
+      }
+      st = go[st * m->nclass + k];
+    }
+    m->chain[i] = m->first[st];
+    m->first[st] = i;
+  }
+  for (i = 0; i < l->length; i++)
+    if (!lits[i])
+      m->always[m->nalways++] = i;
+
+  /* failure links breadth first, turning the trie into the automaton */
+  fail = mem_malloc (m->nstate * sizeof (int));
+  queue = mem_malloc (m->nstate * sizeof (int));
+  head = tail = 0;
+  m->dict[0] = -1;
+  for (k = 0; k < m->nclass; k++) {
+    if ((st = go[k]) > 0 && k > 0) {
+      fail[st] = 0;
+      m->dict[st] = -1;
+      queue[tail++] = st;
+    }
+    else
+      go[k] = 0;
+  }
+  while (head < tail) {
+    i = queue[head++];
+    for (k = 1; k < m->nclass; k++) {
+      st = go[i * m->nclass + k];
+      if (st < 0) {
+        go[i * m->nclass + k] = go[fail[i] * m->nclass + k];
+        continue;
+      }
+      j = go[fail[i] * m->nclass + k];
+      fail[st] = j;
+      m->dict[st] = m->first[j] >= 0 ? j : m->dict[j];
+      queue[tail++] = st;
+    }
+    go[i * m->nclass] = 0;
+  }
+  m->next = go;
+
+  mem_free (&fail);
+  mem_free (&queue);
+  for (i = 0; i < l->length; i++)
+    mem_free (&lits[i]);
+  mem_free (&lits);
+  return (m);
+}
+
+static rx_multi_t* rx_multi_get (const list2_t* l) {
+  int i;
+
+  for (i = 0; i < RX_MULTI_SLOTS; i++)
+    if (RxMulti[i] && RxMulti[i]->list == l) {
+      if (RxMulti[i]->generation == RxGeneration)
+        return (RxMulti[i]);
+      rx_multi_free (&RxMulti[i]);
+      return (RxMulti[i] = rx_multi_build (l));
+    }
+
+  i = RxMultiNext;
+  RxMultiNext = (RxMultiNext + 1) % RX_MULTI_SLOTS;
+  rx_multi_free (&RxMulti[i]);
+  return (RxMulti[i] = rx_multi_build (l));
+}
+
+static int rx_cmp_int (const void* a, const void* b) {
+  return (*((const int*) a) - *((const int*) b));
+}
+
+int rx_list_first (list2_t* l, const char* pat) {
+  rx_multi_t* m;
+  const unsigned char* p;
+  int i, j, st, ncand = 0, a = 0, c = 0;
+
+  if (!pat || list_empty(l))
+    return (-1);
+
+  if (l->length < RX_MULTI_MIN) {
+    for (i = 0; i < l->length; i++)
+      if (REGEXEC(((rx_t*) l->data[i])->rx, pat) == 0)
+        return (i);
+    return (-1);
+  }
+
+  m = rx_multi_get (l);
+  if (++m->stamp == 0) {
+    memset (m->seen, 0, l->length * sizeof (unsigned int));
+    m->stamp = 1;
+  }
+
+  /* collect the expressions whose literal occurs */
+  for (st = 0, p = (const unsigned char*) pat; *p; p++) {
+    st = m->next[st * m->nclass + m->class[*p]];
+    for (j = m->first[st] >= 0 ? st : m->dict[st]; j >= 0; j = m->dict[j])
+      for (i = m->first[j]; i >= 0; i = m->chain[i])
+        if (m->seen[i] != m->stamp) {
+          m->seen[i] = m->stamp;
+          m->cand[ncand++] = i;
+        }
+  }
+  qsort (m->cand, ncand, sizeof (int), rx_cmp_int);
+
+  /* try them and those without literal in list order */
+  while (a < m->nalways || c < ncand) {
+    if (c >= ncand || (a < m->nalways && m->always[a] < m->cand[c]))
+      i = m->always[a++];
+    else
+      i = m->cand[c++];
+    if (REGEXEC(((rx_t*) l->data[i])->rx, pat) == 0)
+      return (i);
+  }
+  return (-1);
+}
+
 int rx_list_match (list2_t* l, const char* pat) {
-  int i = 0;
   if (!pat || !*pat || list_empty(l))
     return (0);
-  for (i = 0; i < l->length; i++)
-    if (REGEXEC(((rx_t*) l->data[i])->rx, pat) == 0)
-      return (1);
-  return (0);
+  return (rx_list_first (l, pat) >= 0);
 }
 
 int rx_lookup (list2_t* l, const char* pat) {
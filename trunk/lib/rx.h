@@ -39,6 +39,7 @@ rx_t* rx_compile (const char*, int);
 /* for handling lists */
 int rx_compare (const rx_t*, const rx_t*);      /* compare two patterns */
 int rx_list_match (list2_t*, const char*);      /* match all items list agains string */
+int rx_list_first (list2_t*, const char*);      /* index of first item matching string */
 int rx_lookup (list2_t*, const char*);          /* lookup pattern */
 
 #define REGCOMP(X,Y,Z) regcomp(X, Y, REG_WORDS|REG_EXTENDED|(Z))
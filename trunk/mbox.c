@@ -17,6 +17,7 @@
 #include "mx.h"
 #include "buffy.h"
 #include "mbox.h"
+#include "ascii.h"
 #include "sort.h"
 #include "thread.h"
 #include "copy.h"
@@ -545,6 +546,82 @@ static int mbox_check_mailbox (CONTEXT* ctx, int* index_hint, int lock) {
  *	0	success
  *	-1	failure
  */
+/*
+ * Finds the value of the header field name (given with its colon) in
+ * the header block hdr; *value is NULL if there is none.  Returns -1 if
+ * the field occurs more than once.
+ */
+static int mbox_find_status (char *hdr, const char *name, char **value,
+                             size_t *len)
+{
+  char *p;
+  size_t n = str_len (name);
+
+  *value = NULL;
+  for (p = hdr; (p = strchr (p, '\n')) != NULL;) {
+    p++;
+    if (ascii_strncasecmp (p, name, n) == 0) {
+      if (*value)
+        return (-1);
+      *value = p + n;
+      *len = strcspn (*value, "\n");
+    }
+  }
+  return (0);
+}
+
+/* overwrites the value of a status field in place with flags */
+static int mbox_write_status (int fd, char *hdr, LOFF_T offset, char *value,
+                              size_t len, const char *flags)
+{
+  size_t n = str_len (flags);
+
+  if (!value)
+    return (n ? -1 : 0);
+  if (n + 1 > len)
+    return (-1);
+  value[0] = ' ';
+  memcpy (value + 1, flags, n);
+  memset (value + 1 + n, ' ', len - n - 1);
+  if (pwrite (fd, value, len, offset + (value - hdr)) != (ssize_t) len)
+    return (-1);
+  return (0);
+}
+
+/*
+ * Messages of which only the flags were changed don't need to be copied:
+ * their Status: and X-Status: values, which we pad when writing them,
+ * are overwritten in place.  Returns -1 if that's not possible and the
+ * message has to be rewritten.
+ */
+static int mbox_update_status (CONTEXT * ctx, HEADER * h)
+{
+  char *hdr, *status, *xstatus;
+  size_t len, slen = 0, xlen = 0;
+  int fd = fileno (ctx->fp);
+  int rc = -1;
+
+  if (h->deleted || h->attach_del ||
+      (h->env && (h->env->irt_changed || h->env->refs_changed)))
+    return (-1);
+
+  len = h->content->offset - h->offset;
+  hdr = mem_malloc (len + 1);
+  if (pread (fd, hdr, len, h->offset) == (ssize_t) len) {
+    hdr[len] = '\0';
+    if (mbox_find_status (hdr, "Status:", &status, &slen) == 0 &&
+        mbox_find_status (hdr, "X-Status:", &xstatus, &xlen) == 0 &&
+        mbox_write_status (fd, hdr, h->offset, status, slen,
+                           h->read ? "RO" : h->old ? "O" : "") == 0 &&
+        mbox_write_status (fd, hdr, h->offset, xstatus, xlen,
+                           h->replied ? (h->flagged ? "AF" : "A") :
+                           h->flagged ? "F" : "") == 0)
+      rc = 0;
+  }
+  mem_free (&hdr);
+  return (rc);
+}
+
 static int _mbox_sync_mailbox (CONTEXT * ctx, int unused, int *index_hint)
 {
   char tempfile[_POSIX_PATH_MAX];
@@ -600,6 +677,66 @@ static int _mbox_sync_mailbox (CONTEXT * ctx, int unused, int *index_hint)
     /* fatal error */
     return (-1);
 
+  /* Save the state of this folder. */
+  if (stat (ctx->path, &statbuf) == -1) {
+    mutt_perror (ctx->path);
+    mutt_sleep (5);
+    goto bail;
+  }
+
+  /* find the first deleted/changed message which can't be updated in
+   * place.  we save a lot of time by only rewriting the mailbox from the
+   * point where it has actually changed.
+   */
+  for (i = 0, j = 0; i < ctx->msgcount; i++) {
+    if (ctx->hdrs[i]->deleted || ctx->hdrs[i]->attach_del)
+      break;
+    if (ctx->hdrs[i]->changed) {
+      if (mbox_update_status (ctx, ctx->hdrs[i]) != 0)
+        break;
+      j++;
+    }
+  }
+  if (i == ctx->msgcount) {
+    if (!j) {
+      /* this means ctx->changed or ctx->deleted was set, but no
+       * messages were found to be changed or deleted.  This should
+       * never happen, is we presume it is a bug in mutt.
+       */
+      mutt_error
+        _("sync: mbox modified, but no modified messages! (report this bug)");
+      mutt_sleep (5);           /* the mutt_error /will/ get cleared! */
+      debug_print (1, ("no modified messages.\n"));
+      goto bail;
+    }
+
+    /* only flags changed and all of them were written in place */
+    debug_print (2, ("updated %d messages in place\n", j));
+    mbox_unlock_mailbox (ctx);
+    if (fclose (ctx->fp) != 0) {
+      ctx->fp = NULL;
+      mutt_perror (ctx->path);
+      mutt_unblock_signals ();
+      mx_fastclose_mailbox (ctx);
+      mutt_sleep (5);
+      return (-1);
+    }
+    utimebuf.actime = statbuf.st_atime;
+    utimebuf.modtime = statbuf.st_mtime;
+    utime (ctx->path, &utimebuf);
+    if ((ctx->fp = fopen (ctx->path, "r")) == NULL) {
+      mutt_unblock_signals ();
+      mx_fastclose_mailbox (ctx);
+      mutt_error _("Fatal error!  Could not reopen mailbox!");
+      return (-1);
+    }
+    mutt_unblock_signals ();
+    return (0);
+  }
+
+  /* save the index of the first changed/deleted message */
+  first = i;
+
   /* Create a temporary file to write the new version of the mailbox in. */
   mutt_mktemp (tempfile);
   if ((i = open (tempfile, O_WRONLY | O_EXCL | O_CREAT, 0600)) == -1 ||
@@ -614,28 +751,8 @@ static int _mbox_sync_mailbox (CONTEXT * ctx, int unused, int *index_hint)
     goto bail;
   }
 
-  /* find the first deleted/changed message.  we save a lot of time by only
-   * rewriting the mailbox from the point where it has actually changed.
-   */
-  for (i = 0; i < ctx->msgcount && !ctx->hdrs[i]->deleted &&
-       !ctx->hdrs[i]->changed && !ctx->hdrs[i]->attach_del; i++);
-  if (i == ctx->msgcount) {
-    /* this means ctx->changed or ctx->deleted was set, but no
-     * messages were found to be changed or deleted.  This should
-     * never happen, is we presume it is a bug in mutt.
-     */
-    mutt_error
-      _("sync: mbox modified, but no modified messages! (report this bug)");
-    mutt_sleep (5);             /* the mutt_error /will/ get cleared! */
-    debug_print (1, ("no modified messages.\n"));
-    unlink (tempfile);
-    goto bail;
-  }
-
-  /* save the index of the first changed/deleted message */
-  first = i;
   /* where to start overwriting */
-  offset = ctx->hdrs[i]->offset;
+  offset = ctx->hdrs[first]->offset;
 
   /* the offset stored in the header does not include the MMDF_SEP, so make
    * sure we seek to the correct location
@@ -683,7 +800,7 @@ static int _mbox_sync_mailbox (CONTEXT * ctx, int unused, int *index_hint)
 
       if (mutt_copy_message
           (fp, ctx, ctx->hdrs[i], M_CM_UPDATE,
-           CH_FROM | CH_UPDATE | CH_UPDATE_LEN) == -1) {
+           CH_FROM | CH_UPDATE | CH_UPDATE_LEN | CH_PADSTATUS) == -1) {
         mutt_perror (tempfile);
         mutt_sleep (5);
         unlink (tempfile);
@@ -730,14 +847,6 @@ static int _mbox_sync_mailbox (CONTEXT * ctx, int unused, int *index_hint)
   }
   fp = NULL;
 
-  /* Save the state of this folder. */
-  if (stat (ctx->path, &statbuf) == -1) {
-    mutt_perror (ctx->path);
-    mutt_sleep (5);
-    unlink (tempfile);
-    goto bail;
-  }
-
   if ((fp = fopen (tempfile, "r")) == NULL) {
     mutt_unblock_signals ();
     mx_fastclose_mailbox (ctx);
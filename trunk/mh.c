@@ -889,7 +889,8 @@ void maildir_delayed_parsing (CONTEXT * ctx, struct maildir *md)
     }
 
     if (data != NULL && !ret && lastchanged.st_mtime <= when->tv_sec) {
-      p->h = mutt_hcache_restore ((unsigned char *) data, &p->h);
+      p->h = mutt_hcache_restore ((unsigned char *) data, &p->h,
+                                  ctx->counting ? M_HCACHE_SUMMARY : 0);
       maildir_parse_flags (p->h, fn);
     }
     else
@@ -1380,10 +1381,31 @@ static int maildir_sync_message (CONTEXT * ctx, int msgno)
   return (0);
 }
 
+/*
+ * Makes the renames and unlinks of a sync durable.  This is done once
+ * for both subdirectories at the end instead of for every message.
+ */
+static void maildir_sync_dirs (CONTEXT * ctx)
+{
+  char buf[_POSIX_PATH_MAX];
+  const char *sub[] = { "new", "cur" };
+  int i, fd;
+
+  for (i = 0; i < 2; i++) {
+    snprintf (buf, sizeof (buf), "%s/%s", ctx->path, sub[i]);
+    if ((fd = open (buf, O_RDONLY)) == -1)
+      continue;
+    /* EINVAL: the file system can't sync directories */
+    if (fsync (fd) == -1 && errno != EINVAL)
+      mutt_perror (buf);
+    close (fd);
+  }
+}
+
 static int mh_sync_mailbox (CONTEXT * ctx, int unused, int *index_hint)
 {
   char path[_POSIX_PATH_MAX], tmp[_POSIX_PATH_MAX];
-  int i, j;
+  int i, j, synced = 0;
 
 #if USE_HCACHE
   void *hc = NULL;
@@ -1397,11 +1419,6 @@ static int mh_sync_mailbox (CONTEXT * ctx, int unused, int *index_hint)
   if (i != 0)
     return i;
 
-#if USE_HCACHE
-  if (ctx->magic == M_MAILDIR)
-    hc = mutt_hcache_open (HeaderCache, ctx->path);
-#endif /* USE_HCACHE */
-
   for (i = 0; i < ctx->msgcount; i++) {
     if (ctx->hdrs[i]->deleted
         && (ctx->magic != M_MAILDIR || !option (OPTMAILDIRTRASH))) {
@@ -1409,11 +1426,17 @@ static int mh_sync_mailbox (CONTEXT * ctx, int unused, int *index_hint)
       if (ctx->magic == M_MAILDIR
           || (option (OPTMHPURGE) && ctx->magic == M_MH)) {
 #if USE_HCACHE
-        if (ctx->magic == M_MAILDIR)
+        /* only deleted messages have to leave the cache: the keys don't
+         * include the flags, so renamed ones keep theirs */
+        if (ctx->magic == M_MAILDIR) {
+          if (!hc)
+            hc = mutt_hcache_open (HeaderCache, ctx->path);
           mutt_hcache_delete (hc, ctx->hdrs[i]->path + 3,
                               &maildir_hcache_keylen);
+        }
 #endif /* USE_HCACHE */
         unlink (path);
+        synced++;
       }
       else if (ctx->magic == M_MH) {
         /* MH just moves files out of the way when you delete them */
@@ -1433,6 +1456,7 @@ static int mh_sync_mailbox (CONTEXT * ctx, int unused, int *index_hint)
       if (ctx->magic == M_MAILDIR) {
         if (maildir_sync_message (ctx, i) == -1)
           goto err;
+        synced++;
       }
       else {
         if (mh_sync_message (ctx, i) == -1)
@@ -1446,6 +1470,9 @@ static int mh_sync_mailbox (CONTEXT * ctx, int unused, int *index_hint)
     mutt_hcache_close (hc);
 #endif /* USE_HCACHE */
 
+  if (ctx->magic == M_MAILDIR && synced)
+    maildir_sync_dirs (ctx);
+
   if (ctx->magic == M_MH)
     mh_update_sequences (ctx);
 
@@ -1608,7 +1635,7 @@ static int maildir_check_mailbox (CONTEXT * ctx, int *index_hint, int unused)
    * of each message we scanned.  This is used in the loop over the
    * existing messages below to do some correlation.
    */
-  fnames = hash_create (1031);
+  fnames = hash_create (ctx->msgcount > 1031 ? ctx->msgcount : 1031);
 
   for (p = md; p; p = p->next) {
     maildir_canon_filename (buf, p->h->path, sizeof (buf));
@@ -1786,46 +1813,82 @@ static int mh_check_mailbox (CONTEXT * ctx, int *index_hint, int unused)
 
 /*
  * These functions try to find a message in a maildir folder when it
- * has moved under our feet.  Note that this code is rather expensive, but
- * then again, it's called rarely.
+ * has moved under our feet.  Instead of reading the subdirectories for
+ * every message, they are read once into an index from unique names to
+ * file names which is kept for the last folder looked at; it is only
+ * read again when a lookup misses or finds a file which has gone.
  */
 
-FILE *_maildir_open_find_message (const char *folder, const char *unique,
-                                  const char *subfolder)
+static struct {
+  char *folder;
+  HASH *names;                  /* canonical name -> "subdir/filename" */
+} MaildirIndex = { NULL, NULL };
+
+static void maildir_index_free_entry (void *p)
+{
+  mem_free (&p);
+}
+
+static void maildir_index_free (void)
+{
+  if (MaildirIndex.names)
+    hash_destroy (&MaildirIndex.names, maildir_index_free_entry);
+  mem_free (&MaildirIndex.folder);
+}
+
+static void maildir_index_scan (const char *folder, const char *subfolder)
 {
   char dir[_POSIX_PATH_MAX];
   char tunique[_POSIX_PATH_MAX];
-  char fname[_POSIX_PATH_MAX];
-
+  size_t ulen, flen;
   DIR *dp;
   struct dirent *de;
-
-  FILE *fp = NULL;
-  int oe = ENOENT;
+  char *e;
 
   snprintf (dir, sizeof (dir), "%s/%s", folder, subfolder);
-
-  if ((dp = opendir (dir)) == NULL) {
-    errno = ENOENT;
-    return NULL;
-  }
+  if ((dp = opendir (dir)) == NULL)
+    return;
 
   while ((de = readdir (dp))) {
+    if (*de->d_name == '.')
+      continue;
     maildir_canon_filename (tunique, de->d_name, sizeof (tunique));
-
-    if (!str_cmp (tunique, unique)) {
-      snprintf (fname, sizeof (fname), "%s/%s/%s", folder, subfolder,
-                de->d_name);
-      fp = fopen (fname, "r");  /* __FOPEN_CHECKED__ */
-      oe = errno;
-      break;
-    }
+    /* key and file name share one allocation, freed through the key */
+    ulen = str_len (tunique) + 1;
+    flen = str_len (subfolder) + 1 + str_len (de->d_name) + 1;
+    e = mem_malloc (ulen + flen);
+    memcpy (e, tunique, ulen);
+    snprintf (e + ulen, flen, "%s/%s", subfolder, de->d_name);
+    if (MaildirIndex.names->nelem < MaildirIndex.names->curnelem * 2)
+      MaildirIndex.names = hash_resize (MaildirIndex.names,
+                                        MaildirIndex.names->nelem * 2);
+    if (hash_insert (MaildirIndex.names, e, e, 0) == -1)
+      mem_free (&e);
   }
 
   closedir (dp);
+}
+
+static void maildir_index_build (const char *folder)
+{
+  maildir_index_free ();
+  MaildirIndex.folder = str_dup (folder);
+  MaildirIndex.names = hash_create (1031);
+  maildir_index_scan (folder, "new");
+  maildir_index_scan (folder, "cur");
+}
+
+static FILE *maildir_index_open (const char *folder, const char *unique)
+{
+  char fname[_POSIX_PATH_MAX];
+  char *e;
 
-  errno = oe;
-  return fp;
+  if (!(e = hash_find (MaildirIndex.names, unique))) {
+    errno = ENOENT;
+    return NULL;
+  }
+  snprintf (fname, sizeof (fname), "%s/%s", folder, e + str_len (e) + 1);
+  return fopen (fname, "r");    /* __FOPEN_CHECKED__ */
 }
 
 FILE *maildir_open_find_message (const char *folder, const char *msg)
@@ -1833,34 +1896,15 @@ FILE *maildir_open_find_message (const char *folder, const char *msg)
   char unique[_POSIX_PATH_MAX];
   FILE *fp;
 
-  static unsigned int new_hits = 0, cur_hits = 0;       /* simple dynamic optimization */
-
   maildir_canon_filename (unique, msg, sizeof (unique));
 
-  if ((fp =
-       _maildir_open_find_message (folder, unique,
-                                   new_hits > cur_hits ? "new" : "cur"))
-      || errno != ENOENT) {
-    if (new_hits < UINT_MAX && cur_hits < UINT_MAX) {
-      new_hits += (new_hits > cur_hits ? 1 : 0);
-      cur_hits += (new_hits > cur_hits ? 0 : 1);
-    }
-
+  if (MaildirIndex.names && !str_cmp (MaildirIndex.folder, folder) &&
+      ((fp = maildir_index_open (folder, unique)) || errno != ENOENT))
     return fp;
-  }
-  if ((fp =
-       _maildir_open_find_message (folder, unique,
-                                   new_hits > cur_hits ? "cur" : "new"))
-      || errno != ENOENT) {
-    if (new_hits < UINT_MAX && cur_hits < UINT_MAX) {
-      new_hits += (new_hits > cur_hits ? 0 : 1);
-      cur_hits += (new_hits > cur_hits ? 1 : 0);
-    }
 
-    return fp;
-  }
-
-  return NULL;
+  /* missing or out of date */
+  maildir_index_build (folder);
+  return maildir_index_open (folder, unique);
 }
 
 
@@ -545,6 +545,7 @@ typedef struct spam_list_t {
 void mutt_free_spam_list (SPAM_LIST **);
 
 int mutt_matches_ignore (const char *, LIST *);
+void mutt_ignore_changed (void);
 
 void mutt_init (int, LIST *);
 
@@ -722,6 +723,8 @@ typedef struct header {
   short recipient;              /* user_is_recipient()'s return value, cached */
 
   int pair;                     /* color-pair to use when displaying in the index */
+  unsigned int pair_gen;        /* ColorIndexGen pair was resolved for, 0
+                                   if it needs to be resolved again */
 
   time_t date_sent;             /* time when the message was sent (UTC) */
   time_t received;              /* time when the message was placed in the mailbox */
@@ -756,6 +759,9 @@ typedef struct header {
 #endif
 
   char *maildir_flags;          /* unknown maildir flags */
+
+  unsigned char *score_cache;   /* cached score rule results, see score.c */
+  int score_cache_len;
 } HEADER;
 
 typedef struct thread {
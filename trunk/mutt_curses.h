@@ -146,6 +146,10 @@ extern int ColorDefs[];
 extern COLOR_LINE *ColorHdrList;
 extern COLOR_LINE *ColorBodyList;
 extern COLOR_LINE *ColorIndexList;
+extern unsigned int ColorIndexGen;
+
+/* invalidates the index colors resolved for all messages */
+void mutt_index_colors_changed (void);
 
 void ci_init_color (void);
 void ci_start_color (void);
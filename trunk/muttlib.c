@@ -227,6 +227,8 @@ HEADER *mutt_dup_header (HEADER * h)
 
   hnew = mutt_new_header ();
   memcpy (hnew, h, sizeof (HEADER));
+  hnew->score_cache = NULL;
+  hnew->score_cache_len = 0;
   return hnew;
 }
 
@@ -237,6 +239,7 @@ void mutt_free_header (HEADER ** h)
   mutt_free_envelope (&(*h)->env);
   mutt_free_body (&(*h)->content);
   mem_free (&(*h)->maildir_flags);
+  mem_free (&(*h)->score_cache);
   mem_free (&(*h)->tree);
   mem_free (&(*h)->path);
 #ifdef MIXMASTER
@@ -248,12 +251,124 @@ void mutt_free_header (HEADER ** h)
   mem_free (h);
 }
 
+/*
+ * Header lines are checked against the ignore lists once per header
+ * of every message displayed, copied or parsed. Instead of comparing
+ * against every entry, the lowercased entries of a list are hashed
+ * and only the prefixes of the line with one of their lengths are
+ * looked up. The index is rebuilt when mutt_ignore_changed() was
+ * called since.
+ */
+
+#define IGNORE_SLOTS    2
+
+typedef struct {
+  LIST *list;
+  unsigned int generation;
+  HASH *prefixes;               /* lowercased entries */
+  int *lens;                    /* distinct lengths, ascending */
+  int nlens;
+  int any;                      /* there is a "*" entry */
+  int linear;                   /* entry too long, walk list instead */
+} ignore_index_t;
+
+static ignore_index_t IgnoreIndex[IGNORE_SLOTS];
+static unsigned int IgnoreGeneration = 1;
+
+void mutt_ignore_changed (void)
+{
+  IgnoreGeneration++;
+}
+
+static void ignore_free_key (void *p)
+{
+  mem_free (&p);
+}
+
+static int ignore_cmp_len (const void *a, const void *b)
+{
+  return *((const int *) a) - *((const int *) b);
+}
+
+static void ignore_index_build (ignore_index_t * idx, LIST * t)
+{
+  LIST *p;
+  char *key;
+  int i, n = 0, len;
+
+  if (idx->prefixes)
+    hash_destroy (&idx->prefixes, ignore_free_key);
+  mem_free (&idx->lens);
+  memset (idx, 0, sizeof (ignore_index_t));
+  idx->list = t;
+  idx->generation = IgnoreGeneration;
+
+  for (p = t; p; p = p->next)
+    n++;
+  idx->prefixes = hash_create (n < 16 ? 16 : 2 * n);
+  idx->lens = mem_malloc ((n + 1) * sizeof (int));
+
+  for (p = t; p; p = p->next) {
+    if (*p->data == '*')
+      idx->any = 1;
+    if ((len = str_len (p->data)) == 0 || len >= STRING) {
+      idx->linear = 1;
+      continue;
+    }
+    key = str_dup (p->data);
+    for (i = 0; key[i]; i++)
+      key[i] = ascii_tolower (key[i]);
+    if (hash_insert (idx->prefixes, key, key, 0) < 0) {
+      mem_free (&key);
+      continue;
+    }
+    for (i = 0; i < idx->nlens && idx->lens[i] != len; i++);
+    if (i == idx->nlens)
+      idx->lens[idx->nlens++] = len;
+  }
+  qsort (idx->lens, idx->nlens, sizeof (int), ignore_cmp_len);
+}
+
 /* returns true if the header contained in "s" is in list "t" */
 int mutt_matches_ignore (const char *s, LIST * t)
 {
-  for (; t; t = t->next) {
-    if (!ascii_strncasecmp (s, t->data, str_len (t->data))
-        || *t->data == '*')
+  ignore_index_t *idx = NULL;
+  char buf[STRING];
+  int i, len = 0;
+
+  if (!t)
+    return 0;
+
+  for (i = 0; i < IGNORE_SLOTS && !idx; i++)
+    if (IgnoreIndex[i].list == t)
+      idx = &IgnoreIndex[i];
+  for (i = 0; i < IGNORE_SLOTS && !idx; i++)
+    if (!IgnoreIndex[i].list)
+      idx = &IgnoreIndex[i];
+  if (!idx)
+    idx = &IgnoreIndex[0];
+  if (idx->list != t || idx->generation != IgnoreGeneration)
+    ignore_index_build (idx, t);
+
+  if (idx->linear) {
+    for (; t; t = t->next) {
+      if (!ascii_strncasecmp (s, t->data, str_len (t->data))
+          || *t->data == '*')
+        return 1;
+    }
+    return 0;
+  }
+
+  if (idx->any)
+    return 1;
+  for (i = 0; i < idx->nlens; i++) {
+    /* extend the lowercased prefix up to the next length */
+    for (; len < idx->lens[i] && s[len]; len++)
+      buf[len] = ascii_tolower (s[len]);
+    if (len < idx->lens[i])
+      break;
+    buf[len] = '\0';
+    if (hash_find (idx->prefixes, buf))
       return 1;
   }
   return 0;
@@ -1325,6 +1440,29 @@ void mutt_free_spam_list (SPAM_LIST ** list)
   }
 }
 
+/*
+ * The expressions of the spam list mirrored as list of rx_t for
+ * rx_list_first(), which only tries those whose literal the string
+ * contains.
+ */
+static list2_t *SpamRx = NULL;
+
+static void mutt_spam_rx_sync (SPAM_LIST * l)
+{
+  SPAM_LIST *p;
+  size_t i = 0;
+
+  for (p = l; p; p = p->next, i++)
+    if (!SpamRx || i >= SpamRx->length || SpamRx->data[i] != p->rx)
+      break;
+  if (!p && SpamRx && i == SpamRx->length)
+    return;
+
+  list_del (&SpamRx, NULL);
+  for (p = l; p; p = p->next)
+    list_push_back (&SpamRx, p->rx);
+}
+
 int mutt_match_spam_list (const char *s, SPAM_LIST * l, char *text, int x)
 {
   static regmatch_t *pmatch = NULL;
@@ -1332,11 +1470,17 @@ int mutt_match_spam_list (const char *s, SPAM_LIST * l, char *text, int x)
   int i, n, tlen;
   char *p;
 
-  if (!s)
+  if (!s || !l)
     return 0;
 
   tlen = 0;
 
+  mutt_spam_rx_sync (l);
+  if ((n = rx_list_first (SpamRx, s)) < 0)
+    return 0;
+  for (; n > 0; n--)
+    l = l->next;
+
   for (; l; l = l->next) {
     /* If this pattern needs more matches, expand pmatch. */
     if (l->nmatch > nmatch) {
@@ -8,6 +8,11 @@
  * please see the file GPL in the top level source directory.
  */
 
+/* for F_OFD_SETLK from <fcntl.h> */
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE 1
+#endif
+
 #if HAVE_CONFIG_H
 # include "config.h"
 #endif
@@ -67,6 +72,13 @@
 #include <string.h>
 #include <ctype.h>
 #include <utime.h>
+#include <time.h>
+
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#include <sys/time.h>
+#include <poll.h>
+#endif
 
 static list2_t* MailboxFormats = NULL;
 #define MX_COMMAND(idx,cmd) ((mx_t*) MailboxFormats->data[idx])->cmd
@@ -75,6 +87,71 @@ static list2_t* MailboxFormats = NULL;
 #define mutt_is_spool(s)  (str_cmp (Spoolfile, s) == 0)
 
 #ifdef USE_DOTLOCK
+/* Wait up to a second for lockfile to go away. With inotify we wake
+ * up as soon as its holder removes it instead of sleeping it out. */
+void mx_wait_lockfile (const char *lockfile)
+{
+  time_t t;
+#ifdef HAVE_SYS_INOTIFY_H
+  char dir[_POSIX_PATH_MAX];
+  union {
+    struct inotify_event ev;
+    char buf[sizeof (struct inotify_event) + _POSIX_PATH_MAX + 1];
+  } u;
+  struct inotify_event *ev;
+  struct timeval start, now;
+  struct pollfd pfd;
+  const char *name;
+  ssize_t len, i;
+  int fd, left;
+
+  if ((name = strrchr (lockfile, '/'))) {
+    strfcpy (dir, lockfile,
+             MIN (sizeof (dir), (name == lockfile ? 1 : name - lockfile) + 1));
+    name++;
+  }
+  else {
+    strfcpy (dir, ".", sizeof (dir));
+    name = lockfile;
+  }
+
+  if ((fd = inotify_init ()) != -1) {
+    if (inotify_add_watch (fd, dir, IN_DELETE | IN_MOVED_FROM) != -1) {
+      gettimeofday (&start, NULL);
+      pfd.fd = fd;
+      pfd.events = POLLIN;
+      /* it may have vanished before the watch was set up */
+      left = access (lockfile, F_OK) == 0 ? 1000 : 0;
+      while (left > 0 && poll (&pfd, 1, left) > 0) {
+        if ((len = read (fd, u.buf, sizeof (u.buf))) <= 0)
+          break;
+        for (i = 0; i < len; i += sizeof (struct inotify_event) + ev->len) {
+          ev = (struct inotify_event *) (u.buf + i);
+          if (ev->len && str_cmp (ev->name, name) == 0)
+            left = 0;
+        }
+        if (left) {
+          gettimeofday (&now, NULL);
+          left = 1000 - ((now.tv_sec - start.tv_sec) * 1000 +
+                         (now.tv_usec - start.tv_usec) / 1000);
+        }
+      }
+      close (fd);
+      return;
+    }
+    close (fd);
+  }
+#endif
+
+  /* don't trust sleep (3) as it may be interrupted
+   * by users sending signals.
+   */
+  t = time (NULL);
+  do {
+    sleep (1);
+  } while (time (NULL) == t);
+}
+
 /* parameters: 
  * path - file to lock
  * retry - should retry if unable to lock?
@@ -82,12 +159,122 @@ static list2_t* MailboxFormats = NULL;
 
 #ifdef DL_STANDALONE
 
+/* A mailbox in a directory we may write to doesn't need the setgid
+ * helper: its dotlock can be taken right here without forking. */
+static int dotlock_is_direct (const char *path)
+{
+  char dir[_POSIX_PATH_MAX];
+  struct stat sb;
+  char *p;
+
+  /* leave symlink chasing to muttng_dotlock */
+  if (lstat (path, &sb) == -1 || !S_ISREG (sb.st_mode))
+    return 0;
+
+  strfcpy (dir, path, sizeof (dir));
+  if ((p = strrchr (dir, '/')))
+    p[p == dir ? 1 : 0] = '\0';
+  else
+    strfcpy (dir, ".", sizeof (dir));
+
+  return access (dir, W_OK) == 0;
+}
+
+/* same NFS-safe scheme as dotlock_lock () in dotlock.c: link a
+ * unique file to path.lock and check the link count */
+static int dotlock_direct_lock (const char *path, int flags, int retry)
+{
+  char lockfile[_POSIX_PATH_MAX + LONG_STRING];
+  char nfslockfile[_POSIX_PATH_MAX + LONG_STRING];
+  size_t prev_size = 0;
+  struct stat sb;
+  int attempts = (flags & DL_FL_RETRY) && !retry ? 0 : MAXLOCKATTEMPT;
+  int count = 0, hard_count = 0;
+  int fd;
+
+  snprintf (nfslockfile, sizeof (nfslockfile), "%s.%s.%d",
+            path, NONULL (Hostname), (int) getpid ());
+  snprintf (lockfile, sizeof (lockfile), "%s.lock", path);
+
+  unlink (nfslockfile);
+  while ((fd = open (nfslockfile, O_WRONLY | O_EXCL | O_CREAT, 0)) < 0)
+    if (errno != EAGAIN)
+      return DL_EX_ERROR;
+  close (fd);
+
+  while (hard_count++ < HARDMAXATTEMPTS) {
+    link (nfslockfile, lockfile);
+
+    if (stat (nfslockfile, &sb) != 0)
+      return DL_EX_ERROR;
+
+    if (sb.st_nlink == 2)
+      break;
+
+    if (count == 0)
+      prev_size = sb.st_size;
+
+    if (prev_size == sb.st_size && ++count > attempts) {
+      if (flags & DL_FL_FORCE) {
+        unlink (lockfile);
+        count = 0;
+        continue;
+      }
+      unlink (nfslockfile);
+      return DL_EX_EXIST;
+    }
+
+    prev_size = sb.st_size;
+
+    mx_wait_lockfile (lockfile);
+  }
+
+  unlink (nfslockfile);
+  return DL_EX_OK;
+}
+
+static int dotlock_direct_unlock (const char *path)
+{
+  char lockfile[_POSIX_PATH_MAX + LONG_STRING];
+
+  snprintf (lockfile, sizeof (lockfile), "%s.lock", path);
+  return unlink (lockfile) == 0 ? DL_EX_OK : DL_EX_ERROR;
+}
+
+static int dotlock_direct (const char *path, int flags, int retry)
+{
+  struct stat sb;
+  int r;
+
+  /* like dotlock_try (): dotlock_is_direct () already found the
+   * directory writable, so the file can be locked */
+  if (flags & DL_FL_TRY)
+    return DL_EX_OK;
+
+  if (flags & DL_FL_UNLOCK)
+    return dotlock_direct_unlock (path);
+
+  if (flags & DL_FL_UNLINK) {
+    if (dotlock_direct_lock (path, flags, retry) != DL_EX_OK)
+      return DL_EX_ERROR;
+    if ((r = lstat (path, &sb)) == 0 && sb.st_size == 0)
+      unlink (path);
+    dotlock_direct_unlock (path);
+    return r == 0 ? DL_EX_OK : DL_EX_ERROR;
+  }
+
+  return dotlock_direct_lock (path, flags, retry);
+}
+
 static int invoke_dotlock (const char *path, int dummy, int flags, int retry)
 {
   char cmd[LONG_STRING + _POSIX_PATH_MAX];
   char f[SHORT_STRING + _POSIX_PATH_MAX];
   char r[SHORT_STRING];
 
+  if (dotlock_is_direct (path))
+    return dotlock_direct (path, flags, retry);
+
   if (flags & DL_FL_RETRY)
     snprintf (r, sizeof (r), "-r %d ", retry ? MAXLOCKATTEMPT : 0);
 
@@ -179,6 +366,71 @@ static int mx_get_idx (const char* path) {
  *	dot		if dot != 0, try to dotlock the file
  *	timeout 	should retry locking?
  */
+#ifdef USE_FCNTL
+#ifdef F_OFD_SETLK
+/* open file description locks belong to the open file rather than to
+ * the process, so closing some other descriptor of the same mailbox
+ * can't drop them; kernels that lack them answer EINVAL. Without
+ * F_OFD_SETLK in <fcntl.h> we stick to plain F_SETLK. */
+static int UseOFDLocks = 1;
+#endif
+
+static int mx_fcntl_setlk (int fd, short type)
+{
+  struct flock lck;
+
+  memset (&lck, 0, sizeof (struct flock));
+  lck.l_type = type;
+  lck.l_whence = SEEK_SET;
+
+#ifdef F_OFD_SETLK
+  if (UseOFDLocks) {
+    if (fcntl (fd, F_OFD_SETLK, &lck) == 0)
+      return 0;
+    if (errno != EINVAL)
+      return -1;
+    debug_print (1, ("no OFD locks, falling back to F_SETLK\n"));
+    UseOFDLocks = 0;
+  }
+#endif
+
+  return fcntl (fd, F_SETLK, &lck);
+}
+
+static int mx_fcntl_trylock (int fd, int excl)
+{
+  return mx_fcntl_setlk (fd, excl ? F_WRLCK : F_RDLCK);
+}
+#endif /* USE_FCNTL */
+
+#ifdef USE_FLOCK
+static int mx_flock_trylock (int fd, int excl)
+{
+  return flock (fd, (excl ? LOCK_EX : LOCK_SH) | LOCK_NB);
+}
+#endif /* USE_FLOCK */
+
+#if defined (USE_FCNTL) || defined (USE_FLOCK)
+#define LOCK_POLL_MS 50
+
+/* rather than sleeping out a whole second before the next attempt,
+ * retry every LOCK_POLL_MS for up to a second; 0 once locked */
+static int mx_lock_poll (int (*trylock) (int, int), int fd, int excl)
+{
+  struct timespec ts;
+  int i;
+
+  ts.tv_sec = 0;
+  ts.tv_nsec = LOCK_POLL_MS * 1000000L;
+  for (i = 0; i < 1000 / LOCK_POLL_MS; i++) {
+    nanosleep (&ts, NULL);
+    if (trylock (fd, excl) == 0)
+      return 0;
+  }
+  return -1;
+}
+#endif
+
 int mx_lock_file (const char *path, int fd, int excl, int dot, int timeout)
 {
 #if defined (USE_FCNTL) || defined (USE_FLOCK)
@@ -189,17 +441,10 @@ int mx_lock_file (const char *path, int fd, int excl, int dot, int timeout)
   int r = 0;
 
 #ifdef USE_FCNTL
-  struct flock lck;
-
-
-  memset (&lck, 0, sizeof (struct flock));
-  lck.l_type = excl ? F_WRLCK : F_RDLCK;
-  lck.l_whence = SEEK_SET;
-
   count = 0;
   attempt = 0;
   prev_sb.st_size = 0;
-  while (fcntl (fd, F_SETLK, &lck) == -1) {
+  while (mx_fcntl_trylock (fd, excl) == -1) {
     struct stat sb;
 
     debug_print (1, ("fcntl errno %d.\n", errno));
@@ -226,14 +471,15 @@ int mx_lock_file (const char *path, int fd, int excl, int dot, int timeout)
     prev_sb = sb;
 
     mutt_message (_("Waiting for fcntl lock... %d"), ++attempt);
-    sleep (1);
+    if (mx_lock_poll (mx_fcntl_trylock, fd, excl) == 0)
+      break;
   }
 #endif /* USE_FCNTL */
 
 #ifdef USE_FLOCK
   count = 0;
   attempt = 0;
-  while (flock (fd, (excl ? LOCK_EX : LOCK_SH) | LOCK_NB) == -1) {
+  while (mx_flock_trylock (fd, excl) == -1) {
     struct stat sb;
 
     if (errno != EWOULDBLOCK) {
@@ -261,7 +507,8 @@ int mx_lock_file (const char *path, int fd, int excl, int dot, int timeout)
     prev_sb = sb;
 
     mutt_message (_("Waiting for flock attempt... %d"), ++attempt);
-    sleep (1);
+    if (mx_lock_poll (mx_flock_trylock, fd, excl) == 0)
+      break;
   }
 #endif /* USE_FLOCK */
 
@@ -274,8 +521,7 @@ int mx_lock_file (const char *path, int fd, int excl, int dot, int timeout)
     /* release any other locks obtained in this routine */
 
 #ifdef USE_FCNTL
-    lck.l_type = F_UNLCK;
-    fcntl (fd, F_SETLK, &lck);
+    mx_fcntl_setlk (fd, F_UNLCK);
 #endif /* USE_FCNTL */
 
 #ifdef USE_FLOCK
@@ -291,12 +537,7 @@ int mx_lock_file (const char *path, int fd, int excl, int dot, int timeout)
 int mx_unlock_file (const char *path, int fd, int dot)
 {
 #ifdef USE_FCNTL
-  struct flock unlockit = { F_UNLCK, 0, 0, 0 };
-
-  memset (&unlockit, 0, sizeof (struct flock));
-  unlockit.l_type = F_UNLCK;
-  unlockit.l_whence = SEEK_SET;
-  fcntl (fd, F_SETLK, &unlockit);
+  mx_fcntl_setlk (fd, F_UNLCK);
 #endif
 
 #ifdef USE_FLOCK
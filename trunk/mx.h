@@ -170,6 +170,7 @@ void mx_update_tables (CONTEXT *, int);
 
 int mx_lock_file (const char *, int, int, int, int);
 int mx_unlock_file (const char *path, int fd, int dot);
+void mx_wait_lockfile (const char *);
 
 int mx_rebuild_cache (void);
 
@@ -165,6 +165,72 @@ void nntp_cache_expand (char *dst, const char *src)
   mutt_expand_path (dst, _POSIX_PATH_MAX);
 }
 
+static void nntp_cache_idx_expand (char *dst, const char *src)
+{
+  nntp_cache_expand (dst, src);
+  str_cat (dst, _POSIX_PATH_MAX, ".idx");
+}
+
+/*
+ * Opens the article index of the group cache file f named cache with
+ * mode.  Returns NULL if there is none or it doesn't match f, otherwise
+ * the index with the number of articles in *count.
+ */
+FILE *nntp_cache_idx_open (const char *cache, FILE * f, const char *mode,
+                           long *count)
+{
+  char file[_POSIX_PATH_MAX];
+  struct stat st, ist;
+  NNTP_CACHE_IDX e;
+  FILE *idx;
+
+  nntp_cache_idx_expand (file, cache);
+  if (!(idx = fopen (file, mode)))
+    return NULL;
+
+  if (fstat (fileno (f), &st) || fstat (fileno (idx), &ist) ||
+      ist.st_size % sizeof (e) ||
+      fread (&e, sizeof (e), 1, idx) != 1 || e.num ||
+      e.magic != NNTP_IDX_MAGIC || e.offset != st.st_size) {
+    debug_print (1, ("%s doesn't match its cache file\n", file));
+    fclose (idx);
+    return NULL;
+  }
+
+  *count = ist.st_size / sizeof (e) - 1;
+  return idx;
+}
+
+/*
+ * Looks up the first of the count articles in idx numbered num or
+ * higher.  Returns the offset of its overview line in the cache file and
+ * its position in *pos, or -1 if there is none.
+ */
+LOFF_T nntp_cache_idx_find (FILE * idx, long count, unsigned int num,
+                            long *pos)
+{
+  NNTP_CACHE_IDX e;
+  long lo = 0, hi = count, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (fseeko (idx, (mid + 1) * sizeof (e), SEEK_SET) ||
+        fread (&e, sizeof (e), 1, idx) != 1)
+      return -1;
+    if (e.num < num)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (lo == count || fseeko (idx, (lo + 1) * sizeof (e), SEEK_SET) ||
+      fread (&e, sizeof (e), 1, idx) != 1)
+    return -1;
+
+  *pos = lo;
+  return e.offset;
+}
+
 /* Loads $news_cache_dir/.index into memory, loads newsserver data
  * and newsgroup cache names */
 static int nntp_parse_cacheindex (NNTP_SERVER * news)
@@ -743,6 +809,34 @@ static int mutt_update_list_file (char *filename, char *section,
   return 0;
 }
 
+/*
+ * Checks whether the newsrc file we wrote last time still holds exactly
+ * buf, so that closing a group without reading anything doesn't rewrite
+ * the lines of every group.
+ */
+static int mutt_newsrc_unchanged (NNTP_SERVER * news, const char *buf)
+{
+  char block[BUFSIZ];
+  struct stat st;
+  size_t len, n;
+  FILE *f;
+  int r = 1;
+
+  len = str_len (buf);
+  if (stat (news->newsrc, &st) || (size_t) st.st_size != len ||
+      st.st_size != news->size || st.st_mtime != news->mtime)
+    return 0;
+  if (!(f = safe_fopen (news->newsrc, "r")))
+    return 0;
+  while (r && len && (n = fread (block, 1, MIN (len, sizeof (block)), f))) {
+    r = !memcmp (block, buf, n);
+    buf += n;
+    len -= n;
+  }
+  fclose (f);
+  return r && !len;
+}
+
 int mutt_newsrc_update (NNTP_SERVER * news)
 {
   char *buf, *line;
@@ -764,8 +858,10 @@ int mutt_newsrc_update (NNTP_SERVER * news)
     debug_print (2, ("Added to newsrc: %s\n", line));
     line += str_len (line);
   }
-  /* newrc being fully rewritten */
-  if (news->newsrc &&
+  /* newrc being fully rewritten, unless nothing has changed at all */
+  if (news->newsrc && mutt_newsrc_unchanged (news, buf))
+    r = 0;
+  else if (news->newsrc &&
       (r = mutt_update_list_file (news->newsrc, NULL, "", buf)) == 0) {
     struct stat st;
 
@@ -837,6 +933,17 @@ void nntp_clear_cacheindex (NNTP_SERVER * news)
   return;
 }
 
+/* Writes the line of the cache ALL describing d */
+static int nntp_write_cache_all_line (FILE * f, NNTP_DATA * d)
+{
+  if (d->desc)
+    return fprintf (f, "%s %d %d %c %s\n", d->group, d->lastMessage,
+                    d->firstMessage, d->allowed ? 'y' : 'n', d->desc) < 0 ?
+      EOF : 0;
+  return fprintf (f, "%s %d %d %c\n", d->group, d->lastMessage,
+                  d->firstMessage, d->allowed ? 'y' : 'n') < 0 ? EOF : 0;
+}
+
 int nntp_save_cache_index (NNTP_SERVER * news)
 {
   char buf[HUGE_STRING];
@@ -865,19 +972,11 @@ int nntp_save_cache_index (NNTP_SERVER * news)
     return -1;
 
   for (l = news->list; l; l = l->next) {
-    if ((d = (NNTP_DATA *) l->data) && !d->deleted) {
-      if (d->desc)
-        snprintf (buf, sizeof (buf), "%s %d %d %c %s\n", d->group,
-                  d->lastMessage, d->firstMessage, d->allowed ? 'y' : 'n',
-                  d->desc);
-      else
-        snprintf (buf, sizeof (buf), "%s %d %d %c\n", d->group,
-                  d->lastMessage, d->firstMessage, d->allowed ? 'y' : 'n');
-      if (fputs (buf, f) == EOF) {
-        fclose (f);
-        unlink (file);
-        return -1;
-      }
+    if ((d = (NNTP_DATA *) l->data) && !d->deleted &&
+        nntp_write_cache_all_line (f, d) == EOF) {
+      fclose (f);
+      unlink (file);
+      return -1;
     }
   }
   fclose (f);
@@ -889,37 +988,120 @@ int nntp_save_cache_index (NNTP_SERVER * news)
   return 0;
 }
 
-int nntp_save_cache_group (CONTEXT * ctx)
+/*
+ * Appends the newsgroups from list on to the cache ALL, as found by
+ * NEWGROUPS, instead of rewriting the lines of all groups known.
+ */
+int nntp_append_cache_index (NNTP_SERVER * news, LIST * list)
 {
-  char buf[HUGE_STRING], addr[STRING];
   char file[_POSIX_PATH_MAX];
+  NNTP_DATA *d;
   FILE *f;
+  int r = 0;
+
+  if (!news || !news->newsgroups)
+    return -1;
+  if (!option (OPTNEWSCACHE))
+    return 0;
+  if (!news->cache)
+    return nntp_save_cache_index (news);
+
+  nntp_cache_expand (file, news->cache);
+  if (!(f = safe_fopen (file, "a")))
+    return nntp_save_cache_index (news);
+
+  for (; list && r != EOF; list = list->next)
+    if ((d = (NNTP_DATA *) list->data) && !d->deleted)
+      r = nntp_write_cache_all_line (f, d);
+  if (fclose (f) == EOF || r == EOF)
+    return nntp_save_cache_index (news);
+
+  return nntp_update_cacheindex (news, NULL);
+}
+
+/*
+ * Checks whether the articles of ctx beyond lastCached can just be
+ * appended to the count articles already in the cache.
+ */
+static int nntp_cache_can_append (CONTEXT * ctx, long count)
+{
+  NNTP_DATA *nntp_data = (NNTP_DATA *) ctx->data;
+  int i;
+
+  for (i = 0; i < ctx->msgcount; i++) {
+    if (ctx->hdrs[i]->article_num > nntp_data->lastCached)
+      count++;
+    /* deleted ones have to be dropped from the cache */
+    else if (ctx->hdrs[i]->deleted)
+      return 0;
+  }
+
+  /* rewrite when it grew well beyond $nntp_context */
+  return !NntpContext || count <= 2 * NntpContext;
+}
+
+int nntp_save_cache_group (CONTEXT * ctx)
+{
+  char buf[HUGE_STRING], addr[STRING];
+  char file[_POSIX_PATH_MAX], idxfile[_POSIX_PATH_MAX];
+  FILE *f = NULL, *idx = NULL;
   HEADER *h;
+  NNTP_DATA *nntp_data;
+  NNTP_CACHE_IDX e;
   struct tm *tm;
   int i = 0, save = SORT_ORDER;
-  int prev = 0;
+  unsigned int prev = 0;
+  long count;
 
   if (!option (OPTNEWSCACHE))
     return 0;
   if (!ctx || !ctx->data || ctx->magic != M_NNTP)
     return -1;
-
-  if (((NNTP_DATA *) ctx->data)->cache) {
-    nntp_cache_expand (file, ((NNTP_DATA *) ctx->data)->cache);
-    unlink (file);
-    f = safe_fopen (file, "w");
+  nntp_data = (NNTP_DATA *) ctx->data;
+
+  if (nntp_data->cache) {
+    nntp_cache_expand (file, nntp_data->cache);
+    /* if the cache and its index are intact, only the articles beyond
+     * lastCached need to be written */
+    if (nntp_data->lastCached && (f = fopen (file, "r+"))) {
+      if ((idx = nntp_cache_idx_open (nntp_data->cache, f, "r+", &count)) &&
+          nntp_cache_can_append (ctx, count) &&
+          !fseeko (f, 0, SEEK_END) && !fseeko (idx, 0, SEEK_END))
+        prev = nntp_data->lastCached;
+      else {
+        safe_fclose (&idx);
+        safe_fclose (&f);
+      }
+    }
+    if (!f) {
+      unlink (file);
+      f = safe_fopen (file, "w");
+    }
   }
   else {
     snprintf (buf, sizeof (buf), "%s-%s",
-              ((NNTP_DATA *) ctx->data)->nserv->conn->account.host,
-              ((NNTP_DATA *) ctx->data)->group);
+              nntp_data->nserv->conn->account.host, nntp_data->group);
     f = mutt_mkname (buf);
-    ((NNTP_DATA *) ctx->data)->cache = str_dup (buf);
+    nntp_data->cache = str_dup (buf);
     nntp_cache_expand (file, buf);
   }
   if (!f)
     return -1;
 
+  nntp_cache_idx_expand (idxfile, nntp_data->cache);
+  if (!idx) {
+    /* the header is written last, so a partly written index is stale */
+    memset (&e, 0, sizeof (e));
+    unlink (idxfile);
+    if (!(idx = safe_fopen (idxfile, "w")) ||
+        fwrite (&e, sizeof (e), 1, idx) != 1) {
+      safe_fclose (&idx);
+      fclose (f);
+      unlink (file);
+      return -1;
+    }
+  }
+
   if (Sort != SORT_ORDER) {
     save = Sort;
     Sort = SORT_ORDER;
@@ -927,12 +1109,16 @@ int nntp_save_cache_group (CONTEXT * ctx)
   }
 
   /* Save only $nntp_context messages... */
-  ((NNTP_DATA *) ctx->data)->lastCached = 0;
-  if (NntpContext && ctx->msgcount > NntpContext)
+  nntp_data->lastCached = 0;
+  if (!prev && NntpContext && ctx->msgcount > NntpContext)
     i = ctx->msgcount - NntpContext;
   for (; i < ctx->msgcount; i++) {
-    if (!ctx->hdrs[i]->deleted && ctx->hdrs[i]->article_num != prev) {
+    /* the index needs ascending article numbers */
+    if (!ctx->hdrs[i]->deleted && ctx->hdrs[i]->article_num > prev) {
       h = ctx->hdrs[i];
+      e.num = h->article_num;
+      e.magic = 0;
+      e.offset = ftello (f);
       addr[0] = 0;
       rfc822_write_address (addr, sizeof (addr), h->env->from, 0);
       tm = gmtime (&h->date_sent);
@@ -946,28 +1132,36 @@ int nntp_save_cache_group (CONTEXT * ctx)
         mutt_write_references (h->env->references, f);
       snprintf (buf, sizeof (buf), "\t" OFF_T_FMT "\t%d\tXref: %s\n",
                 h->content->length, h->lines, NONULL (h->env->xref));
-      if (fputs (buf, f) == EOF) {
+      if (fputs (buf, f) == EOF || fwrite (&e, sizeof (e), 1, idx) != 1) {
         fclose (f);
+        fclose (idx);
         unlink (file);
+        unlink (idxfile);
         return -1;
       }
+      prev = h->article_num;
     }
-    prev = ctx->hdrs[i]->article_num;
   }
 
   if (save != Sort) {
     Sort = save;
     mutt_sort_headers (ctx, 0);
   }
-  fclose (f);
 
-  if (nntp_update_cacheindex (((NNTP_DATA *) ctx->data)->nserv,
-                              (NNTP_DATA *) ctx->data)) {
+  e.num = 0;
+  e.magic = NNTP_IDX_MAGIC;
+  e.offset = ftello (f);
+  if (fclose (f) || fseeko (idx, 0, SEEK_SET) ||
+      fwrite (&e, sizeof (e), 1, idx) != 1)
+    unlink (idxfile);
+  fclose (idx);
+
+  if (nntp_update_cacheindex (nntp_data->nserv, nntp_data)) {
     unlink (file);
+    unlink (idxfile);
     return -1;
   }
-  ((NNTP_DATA *) ctx->data)->lastCached =
-    ((NNTP_DATA *) ctx->data)->lastLoaded;
+  nntp_data->lastCached = nntp_data->lastLoaded;
   return 0;
 }
 
@@ -980,6 +1174,8 @@ void nntp_delete_cache (NNTP_DATA * data)
 
   nntp_cache_expand (buf, data->cache);
   unlink (buf);
+  nntp_cache_idx_expand (buf, data->cache);
+  unlink (buf);
   mem_free (&data->cache);
   data->lastCached = 0;
   nntp_cache_expand (buf, ".index");
@@ -313,6 +313,73 @@ static int mutt_nntp_query (NNTP_DATA * data, char *line, size_t linelen)
   return 0;
 }
 
+/*
+ * Read the lines of a multi-line answer up to the terminating "." and
+ * call funct(*line, *data) for each of them.
+ * Returned codes:
+ *  0 - successful,
+ * -1 - conection lost,
+ * -3 - error in funct(*line, *data).
+ */
+static int nntp_read_lines (NNTP_DATA * nntp_data, char *msg,
+                            progress_t* bar, int (*funct) (char *, void *),
+                            void *data, int tagged)
+{
+  char buf[LONG_STRING];
+  char *inbuf, *p;
+  int chunk, line = 0;
+  long pos = 0;
+  size_t lenbuf = 0;
+  int ret = 0;
+
+  inbuf = mem_malloc (sizeof (buf));
+
+  FOREVER {
+    chunk = mutt_socket_readln_d (buf, sizeof (buf), nntp_data->nserv->conn,
+                                  M_SOCK_LOG_HDR);
+    if (chunk < 0) {
+      ret = -1;
+      break;
+    }
+
+    p = buf;
+    if (!lenbuf && buf[0] == '.') {
+      if (buf[1] == '\0')
+        break;
+      if (buf[1] == '.')
+        p++;
+    }
+
+    strfcpy (inbuf + lenbuf, p, sizeof (buf));
+    pos += chunk;
+
+    if (chunk >= sizeof (buf)) {
+      lenbuf += str_len (p);
+    }
+    else {
+      if (bar) {
+        mutt_progress_bar (bar, pos);
+      } else if (msg) {
+        line++;
+        if (ReadInc && (line % ReadInc == 0)) {
+          if (tagged)
+            mutt_message (_("%s (tagged: %d) %d"), msg, tagged, line);
+          else
+            mutt_message ("%s %d", msg, line);
+        }
+      }
+
+      if (ret == 0 && funct (inbuf, data) < 0)
+        ret = -3;
+      lenbuf = 0;
+    }
+
+    mem_realloc (&inbuf, lenbuf + sizeof (buf));
+  }
+  mem_free (&inbuf);
+  return ret;
+}
+
 /*
  * This function calls  funct(*line, *data)  for each received line,
  * funct(NULL, *data)  if  rewind(*data)  needs, exits when fail or done.
@@ -328,11 +395,6 @@ static int mutt_nntp_fetch (NNTP_DATA * nntp_data, char *query, char *msg,
                             void *data, int tagged)
 {
   char buf[LONG_STRING];
-  char *inbuf, *p;
-  int done = FALSE;
-  int chunk, line;
-  long pos = 0;
-  size_t lenbuf = 0;
   int ret;
 
   do {
@@ -344,56 +406,33 @@ static int mutt_nntp_fetch (NNTP_DATA * nntp_data, char *query, char *msg,
     if (buf[0] != '2')
       return 1;
 
-    ret = 0;
-    line = 0;
-    inbuf = mem_malloc (sizeof (buf));
-
-    FOREVER {
-      chunk = mutt_socket_readln_d (buf, sizeof (buf), nntp_data->nserv->conn,
-                                    M_SOCK_LOG_HDR);
-      if (chunk < 0)
-        break;
-
-      p = buf;
-      if (!lenbuf && buf[0] == '.') {
-        if (buf[1] == '\0') {
-          done = TRUE;
-          break;
-        }
-        if (buf[1] == '.')
-          p++;
-      }
-
-      strfcpy (inbuf + lenbuf, p, sizeof (buf));
-      pos += chunk;
+    ret = nntp_read_lines (nntp_data, msg, bar, funct, data, tagged);
+    funct (NULL, data);
+  }
+  while (ret == -1);
+  return ret;
+}
 
-      if (chunk >= sizeof (buf)) {
-        lenbuf += str_len (p);
-      }
-      else {
-        if (bar) {
-          mutt_progress_bar (bar, pos);
-        } else if (msg) {
-          line++;
-          if (ReadInc && (line % ReadInc == 0)) {
-            if (tagged)
-              mutt_message (_("%s (tagged: %d) %d"), msg, tagged, line);
-            else
-              mutt_message ("%s %d", msg, line);
-          }
-        }
+/*
+ * Like mutt_nntp_fetch() but for a command already sent ahead while
+ * pipelining; the status line is returned in buf.  Unlike
+ * mutt_nntp_fetch(), a lost connection is not recovered from.
+ */
+static int mutt_nntp_fetch_sent (NNTP_DATA * nntp_data, char *buf,
+                                 size_t buflen, int (*funct) (char *, void *),
+                                 void *data)
+{
+  int ret;
 
-        if (ret == 0 && funct (inbuf, data) < 0)
-          ret = -3;
-        lenbuf = 0;
-      }
+  if (mutt_socket_readln (buf, buflen, nntp_data->nserv->conn) < 0)
+    return -1;
+  if (buf[0] == '5')
+    return -2;
+  if (buf[0] != '2')
+    return 1;
 
-      mem_realloc (&inbuf, lenbuf + sizeof (buf));
-    }
-    mem_free (&inbuf);
-    funct (NULL, data);
-  }
-  while (!done);
+  ret = nntp_read_lines (nntp_data, NULL, NULL, funct, data, 0);
+  funct (NULL, data);
   return ret;
 }
 
@@ -446,13 +485,14 @@ static void nntp_parse_xref (CONTEXT * ctx, char *group, char *xref,
 }
 
 /*
+ * if sent, the HEAD command has already been sent ahead
  * returns:
  *  0 on success
  *  1 if article not found
  * -1 if read or write error on tempfile or socket
  */
 static int nntp_read_header (CONTEXT * ctx, const char *msgid,
-                             int article_num)
+                             int article_num, int sent)
 {
   NNTP_DATA *nntp_data = ((NNTP_DATA *) ctx->data);
   FILE *f;
@@ -470,7 +510,11 @@ static int nntp_read_header (CONTEXT * ctx, const char *msgid,
   else
     snprintf (buf, sizeof (buf), "HEAD %s\r\n", msgid);
 
-  ret = mutt_nntp_fetch (nntp_data, buf, NULL, NULL, nntp_read_tempfile, f, 0);
+  if (sent)
+    ret = mutt_nntp_fetch_sent (nntp_data, buf, sizeof (buf),
+                                nntp_read_tempfile, f);
+  else
+    ret = mutt_nntp_fetch (nntp_data, buf, NULL, NULL, nntp_read_tempfile, f, 0);
   if (ret) {
     if (ret != -1)
       debug_print (1, ("%s\n", buf));
@@ -671,6 +715,8 @@ static int add_xover_line (char *line, void *c)
   num = ctx->hdrs[ctx->msgcount]->article_num;
 
   if (num >= fc->first && num <= fc->last && fc->messages[num - fc->base]) {
+    /* don't add it twice if the overview is fetched again */
+    fc->messages[num - fc->base] = 0;
     ctx->msgcount++;
     if (num > data->lastLoaded)
       data->lastLoaded = num;
@@ -687,6 +733,99 @@ static int add_xover_line (char *line, void *c)
 
 #undef fc
 
+/* 420/423: the range of an XOVER command holds no articles */
+#define XOVER_EMPTY(buf) ((buf)[0] == '4' && (buf)[1] == '2' && \
+                          ((buf)[2] == '0' || (buf)[2] == '3'))
+
+/*
+ * mutt_nntp_fetch() for a single XOVER command, which leaves the status
+ * line in status so that empty ranges can be told from failures.
+ */
+static int nntp_fetch_xover_range (NNTP_DATA * nntp_data, FETCH_CONTEXT * fc,
+                                   char *query, char *status,
+                                   size_t statuslen)
+{
+  int ret;
+
+  do {
+    strfcpy (status, query, statuslen);
+    if (mutt_nntp_query (nntp_data, status, statuslen) < 0)
+      return -1;
+    if (status[0] == '5')
+      return -2;
+    if (status[0] != '2')
+      return 1;
+
+    ret = nntp_read_lines (nntp_data, NULL, NULL, add_xover_line, fc, 0);
+    add_xover_line (NULL, fc);
+  }
+  while (ret == -1);
+  return ret;
+}
+
+/*
+ * Fetch the overview of first..last in chunks of NNTP_XOVER_CHUNK
+ * articles.  Once the first chunk went through, the following ones are
+ * pipelined NNTP_PIPELINE_DEPTH commands deep.  Chunks without articles
+ * are skipped, any other failure ends the fetch.
+ * Returns like mutt_nntp_fetch(), with buf holding the failed command.
+ */
+static int nntp_fetch_xover (NNTP_DATA * nntp_data, FETCH_CONTEXT * fc,
+                             unsigned int first, unsigned int last,
+                             char *buf, size_t buflen)
+{
+  char status[LONG_STRING];
+  unsigned int cur, end, next = 0, e;
+  int ret, sent = 0, pipelined = 0, failed = 0;
+
+  for (cur = first; cur <= last && cur >= first; cur = end + 1) {
+    end = last - cur < NNTP_XOVER_CHUNK ? last : cur + NNTP_XOVER_CHUNK - 1;
+
+    if (pipelined) {
+      for (; sent < NNTP_PIPELINE_DEPTH && next <= last && next >= cur;
+           sent++, next = e + 1) {
+        e = last - next < NNTP_XOVER_CHUNK ? last : next + NNTP_XOVER_CHUNK - 1;
+        snprintf (buf, buflen, "XOVER %u-%u\r\n", next, e);
+        if (mutt_socket_write_d (nntp_data->nserv->conn, buf,
+                                 M_SOCK_LOG_CMD) < 0)
+          break;
+      }
+      if (!sent)
+        ret = -1;
+      else {
+        ret = mutt_nntp_fetch_sent (nntp_data, buf, buflen, add_xover_line, fc);
+        sent--;
+      }
+
+      if (ret == 0 || (ret == 1 && XOVER_EMPTY (buf)))
+        continue;
+
+      /* drop the answers still in transit and fetch this chunk again
+       * on its own; mutt_nntp_query() will reconnect, and as failed
+       * is set, all remaining chunks are fetched without pipelining */
+      mutt_socket_close (nntp_data->nserv->conn);
+      pipelined = 0;
+      sent = 0;
+      failed = 1;
+    }
+
+    snprintf (buf, buflen, "XOVER %u-%u\r\n", cur, end);
+    ret = nntp_fetch_xover_range (nntp_data, fc, buf, status,
+                                  sizeof (status));
+    if (ret == 1 && XOVER_EMPTY (status))
+      continue;
+    if (ret != 0)
+      return ret;
+    /* the first chunk settled group selection and authentication */
+    if (!failed && !pipelined) {
+      pipelined = 1;
+      next = end + 1;
+    }
+  }
+
+  return 0;
+}
+
 static int nntp_fetch_headers (CONTEXT * ctx, unsigned int first,
                                unsigned int last)
 {
@@ -697,7 +836,8 @@ static int nntp_fetch_headers (CONTEXT * ctx, unsigned int first,
   int ret;
   int num;
   int oldmsgcount;
-  unsigned int current;
+  unsigned int current, next = 0;
+  int sent = 0, pipelined = 0;
   FILE *f;
   FETCH_CONTEXT fc;
 
@@ -741,14 +881,22 @@ static int nntp_fetch_headers (CONTEXT * ctx, unsigned int first,
     mutt_message (msg2);
 
     if ((f = safe_fopen (buf, "r"))) {
-      int r = 0, c = 0;
-
-      /* counting number of lines */
-      while (fgets (buf, sizeof (buf), f) != NULL)
-        r++;
-      rewind (f);
-      while (r > num && fgets (buf, sizeof (buf), f) != NULL)
-        r--;
+      int r = num, c = 0;
+      long count, pos = 0;
+      LOFF_T off;
+      FILE *idx;
+
+      /* seek right to the first wanted article; caches without a valid
+       * index are read from the start and filtered by add_xover_line() */
+      if ((idx = nntp_cache_idx_open (nntp_data->cache, f, "r", &count))) {
+        if ((off = nntp_cache_idx_find (idx, count, first, &pos)) >= 0) {
+          fseeko (f, off, SEEK_SET);
+          r = count - pos;
+        }
+        else
+          rewind (f);
+        fclose (idx);
+      }
       oldmsgcount = ctx->msgcount;
       fc.first = first;
       fc.last = first + num - 1;
@@ -783,8 +931,7 @@ static int nntp_fetch_headers (CONTEXT * ctx, unsigned int first,
     fc.first = first;
     fc.last = last;
     fc.msg = msg;
-    snprintf (buf, sizeof (buf), "XOVER %d-%d\r\n", first, last);
-    ret = mutt_nntp_fetch (nntp_data, buf, NULL, NULL, add_xover_line, &fc, 0);
+    ret = nntp_fetch_xover (nntp_data, &fc, first, last, buf, sizeof (buf));
     if (ctx->msgcount > oldmsgcount)
       mx_update_context (ctx, ctx->msgcount - oldmsgcount);
     if (ret != 0) {
@@ -812,7 +959,38 @@ static int nntp_fetch_headers (CONTEXT * ctx, unsigned int first,
       h = ctx->hdrs[ctx->msgcount] = mutt_new_header ();
       h->index = ctx->msgcount;
 
-      ret = nntp_read_header (ctx, NULL, current);
+      /* keep up to NNTP_PIPELINE_DEPTH HEAD commands in transit */
+      for (; pipelined && sent < NNTP_PIPELINE_DEPTH && next <= last; next++) {
+        if (!fc.messages[next - fc.base])
+          continue;
+        snprintf (buf, sizeof (buf), "HEAD %u\r\n", next);
+        if (mutt_socket_write_d (nntp_data->nserv->conn, buf,
+                                 M_SOCK_LOG_CMD) < 0)
+          break;
+        sent++;
+      }
+
+      if (current < next) {
+        sent--;
+        ret = nntp_read_header (ctx, NULL, current, 1);
+        if (ret == -1) {
+          /* the connection was lost or the header couldn't be stored;
+           * drop the answers still in transit and go on one at a time,
+           * mutt_nntp_query() will reconnect */
+          mutt_socket_close (nntp_data->nserv->conn);
+          pipelined = sent = next = 0;
+          ret = nntp_read_header (ctx, NULL, current, 0);
+        }
+      }
+      else {
+        ret = nntp_read_header (ctx, NULL, current, 0);
+        /* the first one settled group selection and authentication */
+        if (ret == 0 && !pipelined) {
+          pipelined = 1;
+          next = current + 1;
+        }
+      }
+
       if (ret == 0) {           /* Got article. Fetch next header */
         nntp_get_status (ctx, h, NULL, h->article_num);
         ctx->msgcount++;
@@ -1190,6 +1368,27 @@ int nntp_close_mailbox (CONTEXT * ctx)
   return 0;
 }
 
+/* updates counters after firstMessage and lastMessage were refreshed */
+static void nntp_update_stat (NNTP_DATA * nntp_data, int count)
+{
+  if (!nntp_data->lastMessage || (!nntp_data->rc && !nntp_data->lastCached))
+    nntp_data->unread = count;
+  else
+    mutt_newsgroup_stat (nntp_data);
+  /* active was renumbered? */
+  if (nntp_data->lastMessage < nntp_data->lastLoaded) {
+    if (!nntp_data->max) {
+      nntp_data->entries = mem_calloc (5, sizeof (NEWSRC_ENTRY));
+      nntp_data->max = 5;
+    }
+    nntp_data->lastCached = 0;
+    nntp_data->num = 1;
+    nntp_data->entries[0].first = 1;
+    nntp_data->entries[0].last = 0;
+  }
+  nntp_sync_sidebar (nntp_data);
+}
+
 /* use the GROUP command to poll for new mail */
 static int _nntp_check_mailbox (CONTEXT * ctx, NNTP_DATA * nntp_data)
 {
@@ -1227,22 +1426,7 @@ static int _nntp_check_mailbox (CONTEXT * ctx, NNTP_DATA * nntp_data)
       time (&nntp_data->nserv->check_time);
       return 1;
     }
-    if (!last || (!nntp_data->rc && !nntp_data->lastCached))
-      nntp_data->unread = count;
-    else
-      mutt_newsgroup_stat (nntp_data);
-    /* active was renumbered? */
-    if (last < nntp_data->lastLoaded) {
-      if (!nntp_data->max) {
-        nntp_data->entries = mem_calloc (5, sizeof (NEWSRC_ENTRY));
-        nntp_data->max = 5;
-      }
-      nntp_data->lastCached = 0;
-      nntp_data->num = 1;
-      nntp_data->entries[0].first = 1;
-      nntp_data->entries[0].last = 0;
-    }
-    nntp_sync_sidebar (nntp_data);
+    nntp_update_stat (nntp_data, count);
   }
 
   time (&nntp_data->nserv->check_time);
@@ -1307,6 +1491,94 @@ static int add_group (char *buf, void *serv)
 #undef s
 }
 
+/* refreshes a subscribed group from a line of LIST ACTIVE */
+static int update_active (char *buf, void *serv)
+{
+  char group[LONG_STRING];
+  int first, last;
+  NNTP_DATA *nntp_data;
+
+  if (!buf || sscanf (buf, "%s %d %d", group, &last, &first) != 3)
+    return 0;
+  nntp_data = (NNTP_DATA *) hash_find (((NNTP_SERVER *) serv)->newsgroups,
+                                       group);
+  if (!nntp_data || !nntp_data->subscribed)
+    return 0;
+  nntp_data->firstMessage = first;
+  nntp_data->lastMessage = last;
+  nntp_update_stat (nntp_data, last && first <= last ? last - first + 1 : 0);
+  return 0;
+}
+
+#define LIST_ACTIVE "LIST ACTIVE "
+
+/* whether a group can be given to LIST ACTIVE as a wildmat */
+static int nntp_active_listable (NNTP_DATA * data)
+{
+  return !strpbrk (data->group, "*?[]\\!,") &&
+    sizeof (LIST_ACTIVE) + str_len (data->group) + 2 <= NNTP_LINE_LEN + 1;
+}
+
+/*
+ * Checks all subscribed groups for new news by asking for their active
+ * lines with as few "LIST ACTIVE group,group,..." as fit into a command
+ * line instead of selecting every group.  Groups whose names can't be
+ * given as a wildmat are selected.  If the server doesn't know LIST
+ * ACTIVE with a wildmat, the groups not updated yet are selected, too.
+ */
+static void nntp_check_subscribed (NNTP_SERVER * serv)
+{
+  char buf[NNTP_LINE_LEN + 1];
+  NNTP_DATA nntp_data;
+  NNTP_DATA *data;
+  LIST *l, *start;
+  size_t len, glen;
+  int base;
+
+  for (l = serv->list; l; l = l->next) {
+    data = (NNTP_DATA *) l->data;
+    if (data && data->subscribed && !nntp_active_listable (data)) {
+      serv->check_time = 0;     /* really check! */
+      _nntp_check_mailbox (NULL, data);
+    }
+  }
+
+  nntp_data.nserv = serv;
+  nntp_data.group = NULL;
+  base = snprintf (buf, sizeof (buf), "%s", LIST_ACTIVE);
+  for (l = serv->list; l;) {
+    start = l;
+    for (len = base; l; l = l->next) {
+      data = (NNTP_DATA *) l->data;
+      if (!data || !data->subscribed || !nntp_active_listable (data))
+        continue;
+      glen = str_len (data->group);
+      if (len + glen + 3 > sizeof (buf))
+        break;
+      if (len > base)
+        buf[len++] = ',';
+      memcpy (buf + len, data->group, glen);
+      len += glen;
+    }
+    if (len == base)
+      break;
+    strcpy (buf + len, "\r\n");
+    if (mutt_nntp_fetch (&nntp_data, buf, NULL, NULL, update_active, serv,
+                         0) != 0) {
+      /* the groups of this and the following commands are left */
+      for (l = start; l; l = l->next) {
+        data = (NNTP_DATA *) l->data;
+        if (data && data->subscribed && nntp_active_listable (data)) {
+          serv->check_time = 0; /* really check! */
+          _nntp_check_mailbox (NULL, data);
+        }
+      }
+      break;
+    }
+  }
+  time (&serv->check_time);
+}
+
 int nntp_check_newgroups (NNTP_SERVER * serv, int force)
 {
   char buf[LONG_STRING];
@@ -1326,11 +1598,7 @@ int nntp_check_newgroups (NNTP_SERVER * serv, int force)
   if (option (OPTSHOWNEWNEWS)) {
     mutt_message _("Checking for new messages...");
 
-    for (l = serv->list; l; l = l->next) {
-      serv->check_time = 0;     /* really check! */
-      if (l->data && ((NNTP_DATA *) l->data)->subscribed)
-        _nntp_check_mailbox (NULL, (NNTP_DATA *) l->data);
-    }
+    nntp_check_subscribed (serv);
     sidebar_draw (CurrentMenu);
   }
   else if (!force)
@@ -1372,7 +1640,7 @@ int nntp_check_newgroups (NNTP_SERVER * serv, int force)
                    NULL, NULL);
   }
   if (emp.next)
-    nntp_save_cache_index (serv);
+    nntp_append_cache_index (serv, emp.next);
   mutt_clear_error ();
   return _checked;
 }
@@ -1465,7 +1733,7 @@ int nntp_check_msgid (CONTEXT * ctx, const char *msgid)
   ctx->hdrs[ctx->msgcount]->index = ctx->msgcount;
 
   mutt_message (_("Fetching %s from server..."), msgid);
-  ret = nntp_read_header (ctx, msgid, 0);
+  ret = nntp_read_header (ctx, msgid, 0, 0);
   /* since nntp_read_header() may set read flag, we must reset it */
   ctx->hdrs[ctx->msgcount]->read = 0;
   if (ret != 0)
@@ -23,6 +23,15 @@
 /* number of entries in the hash table */
 #define NNTP_CACHE_LEN 10
 
+/* number of articles asked for per XOVER command */
+#define NNTP_XOVER_CHUNK 5000
+
+/* number of XOVER/HEAD commands sent ahead of their answers */
+#define NNTP_PIPELINE_DEPTH 16
+
+/* maximum length of a command line including CRLF (RFC 3977) */
+#define NNTP_LINE_LEN 512
+
 enum {
   NNTP_NONE = 0,
   NNTP_OK,
@@ -58,6 +67,17 @@ typedef struct {
   char *path;
 } NNTP_CACHE;
 
+/* entry of the binary article index kept next to a group's overview
+ * cache; the first one is a header describing the cache file */
+typedef struct {
+  unsigned int num;             /* article number, 0 for the header */
+  unsigned int magic;           /* NNTP_IDX_MAGIC in the header */
+  LOFF_T offset;                /* offset of the overview line, length of
+                                 * the cache file in the header */
+} NNTP_CACHE_IDX;
+
+#define NNTP_IDX_MAGIC 0x4e494458
+
 typedef struct {
   NEWSRC_ENTRY *entries;
   unsigned int num;             /* number of used entries */
@@ -83,6 +103,7 @@ typedef struct {
 int nntp_get_active (NNTP_SERVER *);
 int nntp_get_cache_all (NNTP_SERVER *);
 int nntp_save_cache_index (NNTP_SERVER *);
+int nntp_append_cache_index (NNTP_SERVER *, LIST *);
 int nntp_check_newgroups (NNTP_SERVER *, int);
 int nntp_save_cache_group (CONTEXT *);
 int nntp_parse_url (const char *, ACCOUNT *, char *, size_t);
@@ -92,6 +113,8 @@ void mutt_newsgroup_stat (NNTP_DATA *);
 void nntp_delete_cache (NNTP_DATA *);
 void nntp_add_to_list (NNTP_SERVER *, NNTP_DATA *);
 void nntp_cache_expand (char *, const char *);
+FILE *nntp_cache_idx_open (const char *, FILE *, const char *, long *);
+LOFF_T nntp_cache_idx_find (FILE *, long, unsigned int, long *);
 void nntp_delete_data (void *);
 
 /* exposed interface */
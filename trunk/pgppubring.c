@@ -38,6 +38,11 @@
 # include <getopt.h>
 #endif
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
 
 extern char *optarg;
 extern int optind;
@@ -52,6 +57,10 @@ short Umask;                    /* dirty hack because we need Umask in lib.c but
 
 #define MD5_DIGEST_LENGTH  16
 
+/* first line of a key ring index; followed by the ring's size,
+ * mtime and inode so that a stale index is noticed */
+#define INDEX_MAGIC "pgpring-index 1"
+
 #ifdef HAVE_FGETPOS
 #define FGETPOS(fp,pos) fgetpos((fp),&(pos))
 #define FSETPOS(fp,pos) fsetpos((fp),&(pos))
@@ -338,6 +347,7 @@ static pgp_key_t pgp_parse_pgp3_key (unsigned char *buff, size_t l)
 
   pgp_make_pgp3_fingerprint (buff, j, digest);
   p->fp_len = SHA_DIGEST_LENGTH;
+  memcpy (p->fingerprint, digest, SHA_DIGEST_LENGTH);
 
   for (k = 0; k < 2; k++) {
     for (id = 0, i = SHA_DIGEST_LENGTH - 8 + k * 4;
@@ -722,10 +732,9 @@ static int pgpring_string_matches_hint (const char *s, const char *hints[],
  * matching IDs.
  */
 
-static void pgpring_find_candidates (char *ringfile, const char *hints[],
+static void pgpring_scan_candidates (FILE * rfp, const char *hints[],
                                      int nhints)
 {
-  FILE *rfp;
 
 #ifdef HAVE_FGETPOS
   fpos_t pos, keypos;
@@ -739,18 +748,6 @@ static void pgpring_find_candidates (char *ringfile, const char *hints[],
 
   short err = 0;
 
-  if ((rfp = fopen (ringfile, "r")) == NULL) {
-    char *error_buf;
-    size_t error_buf_len;
-
-    error_buf_len = sizeof ("fopen: ") - 1 + str_len (ringfile) + 1;
-    error_buf = mem_malloc (error_buf_len);
-    snprintf (error_buf, error_buf_len, "fopen: %s", ringfile);
-    perror (error_buf);
-    mem_free (&error_buf);
-    return;
-  }
-
   FGETPOS (rfp, pos);
   FGETPOS (rfp, keypos);
 
@@ -790,9 +787,384 @@ static void pgpring_find_candidates (char *ringfile, const char *hints[],
 
     FGETPOS (rfp, pos);
   }
+}
 
-  fclose (rfp);
 
+/*
+ * Packet scanner working on the mapped key ring. Returns the tag of
+ * the packet at *off, or -1 at the end or on garbage, points *body
+ * and *blen at its contents and advances *off past it. Partial
+ * lengths are only used by data packets, which don't belong into key
+ * rings; their contents are skipped and *body is NULL.
+ */
+
+static int pgp_map_packet (const unsigned char *map, size_t size,
+                           size_t * off, const unsigned char **body,
+                           size_t * blen)
+{
+  size_t o = *off;
+  size_t material = 0;
+  unsigned char ctb, b;
+  int tag, partial = 0, chunks = 0;
+
+  *body = NULL;
+  *blen = 0;
+
+  if (o >= size || !((ctb = map[o++]) & 0x80))
+    return -1;
+
+  if (ctb & 0x40) {             /* handle PGP 5.0 packets. */
+    tag = ctb & 0x3f;
+    do {
+      if (o >= size)
+        return -1;
+      b = map[o++];
+      if (b < 192) {
+        material = b;
+        partial = 0;
+      }
+      else if (b <= 223) {
+        if (o >= size)
+          return -1;
+        material = ((b - 192) << 8) + map[o++] + 192;
+        partial = 0;
+      }
+      else if (b < 255) {
+        material = 1 << (b & 0x1f);
+        partial = 1;
+      }
+      else {
+        if (size - o < 4)
+          return -1;
+        material = (map[o] << 24) | (map[o + 1] << 16) |
+          (map[o + 2] << 8) | map[o + 3];
+        o += 4;
+        partial = 0;
+      }
+      if (material > size - o)
+        return -1;
+      o += material;
+      chunks++;
+    } while (partial);
+
+    if (chunks == 1) {
+      *body = map + o - material;
+      *blen = material;
+    }
+  }
+  else {                        /* Old-Style PGP */
+    int i, bytes;
+
+    tag = (ctb >> 2) & 0x0f;
+    switch (ctb & 0x03) {
+    case 0:
+      bytes = 1;
+      break;
+    case 1:
+      bytes = 2;
+      break;
+    case 2:
+      bytes = 4;
+      break;
+    default:
+      return -1;
+    }
+    if (size - o < bytes)
+      return -1;
+    for (i = 0; i < bytes; i++)
+      material = (material << 8) + map[o++];
+    if (material > size - o)
+      return -1;
+    *body = map + o;
+    *blen = material;
+    o += material;
+  }
+
+  *off = o;
+  return tag;
+}
+
+/*
+ * Write the index of a key ring: one "K <offset> <keyid> <fingerprint>"
+ * line per (sub)key and one "U <offset> <user id>" line per user ID,
+ * in ring order, where offset is that of the key block. Backslashes
+ * and newlines in user IDs are escaped.
+ */
+
+static void pgpring_write_index (const unsigned char *map, size_t size,
+                                 FILE * idx)
+{
+  const unsigned char *body;
+  unsigned char *buff = NULL;
+  size_t off = 0, start, keyoff = 0, blen, i;
+  pgp_key_t k;
+  int tag;
+
+  for (;;) {
+    start = off;
+    if ((tag = pgp_map_packet (map, size, &off, &body, &blen)) == -1)
+      break;
+    if (!body)
+      continue;
+
+    switch (tag) {
+    case PT_SECKEY:
+    case PT_PUBKEY:
+      keyoff = start;
+      /* fall through */
+    case PT_SUBKEY:
+    case PT_SUBSECKEY:
+      /* pgp_parse_keyinfo () wants the tag in front */
+      mem_realloc (&buff, blen + 1);
+      buff[0] = 0x80 | tag;
+      memcpy (buff + 1, body, blen);
+      if ((k = pgp_parse_keyinfo (buff, blen + 1))) {
+        fprintf (idx, "K %lu %s ", (unsigned long) keyoff, k->keyid);
+        for (i = 0; i < k->fp_len; i++)
+          fprintf (idx, "%02X", k->fingerprint[i]);
+        fputc ('\n', idx);
+        pgp_free_key (&k);
+      }
+      break;
+
+    case PT_NAME:
+      fprintf (idx, "U %lu ", (unsigned long) keyoff);
+      for (i = 0; i < blen && body[i]; i++) {
+        if (body[i] == '\\')
+          fputs ("\\\\", idx);
+        else if (body[i] == '\n')
+          fputs ("\\n", idx);
+        else
+          fputc (body[i], idx);
+      }
+      fputc ('\n', idx);
+      break;
+    }
+  }
+
+  mem_free (&buff);
+}
+
+/* index files are tried next to the ring first, then in $HOME */
+static int pgpring_index_path (char *path, size_t l, const char *ringfile,
+                               int n)
+{
+  MD5_CTX md5;
+  unsigned char sum[MD5_DIGEST_LENGTH];
+  const char *home;
+
+  switch (n) {
+  case 0:
+    snprintf (path, l, "%s.idx", ringfile);
+    return 0;
+  case 1:
+    if (!(home = getenv ("HOME")))
+      return -1;
+    MD5Init (&md5);
+    MD5Update (&md5, (unsigned char *) ringfile, str_len (ringfile));
+    MD5Final (sum, &md5);
+    snprintf (path, l, "%s/.pgpring-%02x%02x%02x%02x%02x%02x%02x%02x.idx",
+              home, sum[0], sum[1], sum[2], sum[3], sum[4], sum[5], sum[6],
+              sum[7]);
+    return 0;
+  default:
+    return -1;
+  }
+}
+
+/* (re)build the index from the mapped ring into the first location
+ * that takes it, or a temporary file if none does */
+static FILE *pgpring_build_index (const char *ringfile, FILE * rfp,
+                                  const char *header)
+{
+  struct stat sb;
+  unsigned char *map;
+  char path[_POSIX_PATH_MAX], tmp[_POSIX_PATH_MAX + SHORT_STRING];
+  FILE *idx = NULL;
+  int n, fd;
+
+  if (fstat (fileno (rfp), &sb) == -1)
+    return NULL;
+
+#ifdef HAVE_MMAP
+  map = sb.st_size ? mmap (NULL, sb.st_size, PROT_READ, MAP_SHARED,
+                           fileno (rfp), 0) : NULL;
+  if (map == MAP_FAILED)
+    return NULL;
+#else
+  map = mem_malloc (sb.st_size);
+  if (fread (map, 1, sb.st_size, rfp) != (size_t) sb.st_size) {
+    mem_free (&map);
+    return NULL;
+  }
+#endif
+
+  for (n = 0; !idx && pgpring_index_path (path, sizeof (path), ringfile,
+                                          n) == 0; n++) {
+    snprintf (tmp, sizeof (tmp), "%s.%d", path, (int) getpid ());
+    /* it lists the user IDs of the secret ring, too */
+    if ((fd = open (tmp, O_RDWR | O_CREAT | O_EXCL, 0600)) == -1)
+      continue;
+    if (!(idx = fdopen (fd, "w+"))) {
+      close (fd);
+      unlink (tmp);
+      continue;
+    }
+    fprintf (idx, "%s\n", header);
+    pgpring_write_index (map, sb.st_size, idx);
+    if (fflush (idx) != 0 || rename (tmp, path) == -1) {
+      fclose (idx);
+      unlink (tmp);
+      idx = NULL;
+    }
+  }
+
+  if (!idx && (idx = tmpfile ())) {
+    fprintf (idx, "%s\n", header);
+    pgpring_write_index (map, sb.st_size, idx);
+  }
+
+#ifdef HAVE_MMAP
+  if (map)
+    munmap (map, sb.st_size);
+#else
+  mem_free (&map);
+#endif
+
+  if (idx) {
+    rewind (idx);
+    fgets (path, sizeof (path), idx);   /* skip header */
+  }
+  return idx;
+}
+
+/* an up to date index for the ring, positioned after its header */
+static FILE *pgpring_open_index (const char *ringfile, FILE * rfp)
+{
+  char header[STRING], buf[STRING];
+  char path[_POSIX_PATH_MAX];
+  struct stat sb;
+  FILE *idx;
+  int n;
+
+  if (fstat (fileno (rfp), &sb) == -1)
+    return NULL;
+
+  snprintf (header, sizeof (header), "%s %lu %lu %lu", INDEX_MAGIC,
+            (unsigned long) sb.st_size, (unsigned long) sb.st_mtime,
+            (unsigned long) sb.st_ino);
+
+  for (n = 0; pgpring_index_path (path, sizeof (path), ringfile, n) == 0;
+       n++) {
+    if (!(idx = fopen (path, "r")))
+      continue;
+    if (fgets (buf, sizeof (buf), idx) && !strncmp (buf, header,
+                                                     str_len (header))
+        && buf[str_len (header)] == '\n')
+      return idx;
+    fclose (idx);
+  }
+
+  return pgpring_build_index (ringfile, rfp, header);
+}
+
+static int pgpring_keyid_matches_hint (const char *keyid, const char *fpr,
+                                       const char *hints[], int nhints)
+{
+  size_t hl, kl = str_len (keyid);
+  const char *h;
+  int i;
+
+  for (i = 0; i < nhints; i++) {
+    h = hints[i];
+    if (!str_ncasecmp (h, "0x", 2))
+      h += 2;
+    hl = str_len (h);
+    if ((hl == 8 || hl == 16) && hl <= kl && !str_casecmp (keyid + kl - hl, h))
+      return 1;
+    if (hl >= 32 && !str_casecmp (fpr, h))
+      return 1;
+  }
+
+  return 0;
+}
+
+/* 
+ * Look up keys with matching IDs in the key ring's index and dump
+ * their key blocks straight from the ring.
+ */
+
+static void pgpring_find_candidates (char *ringfile, const char *hints[],
+                                     int nhints)
+{
+  FILE *rfp, *idx;
+  char buf[HUGE_STRING];
+  char keyid[STRING], fpr[STRING];
+  unsigned long off, dumped = 0;
+  int have_dumped = 0, match;
+  char *p, *q, *uid;
+
+  if ((rfp = fopen (ringfile, "r")) == NULL) {
+    char *error_buf;
+    size_t error_buf_len;
+
+    error_buf_len = sizeof ("fopen: ") - 1 + str_len (ringfile) + 1;
+    error_buf = mem_malloc (error_buf_len);
+    snprintf (error_buf, error_buf_len, "fopen: %s", ringfile);
+    perror (error_buf);
+    mem_free (&error_buf);
+    return;
+  }
+
+  if (!(idx = pgpring_open_index (ringfile, rfp))) {
+    pgpring_scan_candidates (rfp, hints, nhints);
+    fclose (rfp);
+    return;
+  }
+
+  while (fgets (buf, sizeof (buf), idx)) {
+    if ((p = strchr (buf, '\n')))
+      *p = '\0';
+
+    match = 0;
+    if (buf[0] == 'K') {
+      *fpr = '\0';
+      if (sscanf (buf, "K %lu %127s %127s", &off, keyid, fpr) < 2)
+        continue;
+      match = nhints && pgpring_keyid_matches_hint (keyid, fpr, hints,
+                                                    nhints);
+    }
+    else if (buf[0] == 'U') {
+      if (sscanf (buf, "U %lu", &off) != 1
+          || !(uid = strchr (buf + 2, ' ')))
+        continue;
+      /* unescape in place */
+      for (p = q = ++uid; *p; p++, q++) {
+        if (*p == '\\' && p[1])
+          *q = *++p == 'n' ? '\n' : *p;
+        else
+          *q = *p;
+      }
+      *q = '\0';
+      match = pgpring_string_matches_hint (uid, hints, nhints);
+    }
+
+    if (match && !(have_dumped && off == dumped)) {
+      pgp_key_t k;
+
+      fseeko (rfp, (LOFF_T) off, SEEK_SET);
+      if ((k = pgp_parse_keyblock (rfp)) == NULL)
+        break;
+
+      pgpring_dump_keyblock (k);
+      pgp_free_key (&k);
+      dumped = off;
+      have_dumped = 1;
+    }
+  }
+
+  fclose (idx);
+  fclose (rfp);
 }
 
 static void print_userid (const char *id)
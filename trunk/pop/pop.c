@@ -16,6 +16,9 @@
 #include "pop.h"
 #include "mutt_crypt.h"
 #include "mutt_curses.h"
+#if USE_HCACHE
+#include "hcache.h"
+#endif
 
 #include "lib/mem.h"
 #include "lib/str.h"
@@ -38,35 +41,43 @@ static int fetch_message (char *line, void *file)
 }
 
 /*
- * Read header
+ * Read header into h using the temporary file f; if pipelined, LIST and
+ * TOP have already been sent.
  * returns:
  *  0 on success
  * -1 - conection lost,
  * -2 - invalid command or execution error,
  * -3 - error writing to tempfile
  */
-static pop_query_status pop_read_header (POP_DATA * pop_data, HEADER * h)
+static pop_query_status pop_read_header (POP_DATA * pop_data, HEADER * h,
+                                         FILE * f, int pipelined)
 {
-  FILE *f;
   int index;
   pop_query_status ret;
   long length;
   char buf[LONG_STRING];
-  char tempfile[_POSIX_PATH_MAX];
 
-  mutt_mktemp (tempfile);
-  if (!(f = safe_fopen (tempfile, "w+"))) {
-    mutt_perror (tempfile);
-    return PFD_FUNCT_ERROR;
+  rewind (f);
+  if (ftruncate (fileno (f), 0) == -1)
+    ret = PFD_FUNCT_ERROR;
+  else if (pipelined)
+    ret = pop_read_response (pop_data, "LIST", buf, sizeof (buf));
+  else {
+    snprintf (buf, sizeof (buf), "LIST %d\r\n", h->refno);
+    ret = pop_query (pop_data, buf, sizeof (buf));
   }
-
-  snprintf (buf, sizeof (buf), "LIST %d\r\n", h->refno);
-  ret = pop_query (pop_data, buf, sizeof (buf));
   if (ret == PQ_OK) {
     sscanf (buf, "+OK %d %ld", &index, &length);
 
-    snprintf (buf, sizeof (buf), "TOP %d 0\r\n", h->refno);
-    ret = pop_fetch_data (pop_data, buf, NULL, fetch_message, f);
+    if (pipelined) {
+      ret = pop_read_response (pop_data, "TOP", buf, sizeof (buf));
+      if (ret == PQ_OK)
+        ret = pop_read_data (pop_data, NULL, fetch_message, f);
+    }
+    else {
+      snprintf (buf, sizeof (buf), "TOP %d 0\r\n", h->refno);
+      ret = pop_fetch_data (pop_data, buf, NULL, fetch_message, f);
+    }
 
     if (pop_data->cmd_top == CMD_UNKNOWN) {
       if (ret == PQ_OK) {
@@ -116,42 +127,78 @@ static pop_query_status pop_read_header (POP_DATA * pop_data, HEADER * h)
     }
   }
 
-  fclose (f);
-  unlink (tempfile);
   return ret;
 }
 
+/*
+ * Send LIST and TOP for up to POP_PIPELINE_DEPTH messages from first on
+ * which still need their headers downloaded.
+ * returns the index after the last message sent for, -1 if the
+ * connection was lost.
+ */
+static int pop_send_header_cmds (CONTEXT * ctx, int first, int last)
+{
+  int i, n;
+  char buf[SHORT_STRING];
+  POP_DATA *pop_data = (POP_DATA *) ctx->data;
+
+  for (i = first, n = 0; i < last && n < POP_PIPELINE_DEPTH; i++) {
+    if (ctx->hdrs[i]->env)
+      continue;
+    snprintf (buf, sizeof (buf), "LIST %d\r\nTOP %d 0\r\n",
+              ctx->hdrs[i]->refno, ctx->hdrs[i]->refno);
+    if (mutt_socket_write_d (pop_data->conn, buf, M_SOCK_LOG_CMD) < 0) {
+      pop_data->status = POP_DISCONNECTED;
+      return -1;
+    }
+    n++;
+  }
+
+  return i;
+}
+
 /* parse UIDL */
 static int fetch_uidl (char *line, void *data)
 {
   int i, index;
   CONTEXT *ctx = (CONTEXT *) data;
   POP_DATA *pop_data = (POP_DATA *) ctx->data;
+  HEADER *h;
 
   sscanf (line, "%d %s", &index, line);
-  for (i = 0; i < ctx->msgcount; i++)
-    if (!str_cmp (line, ctx->hdrs[i]->data))
-      break;
 
-  if (i == ctx->msgcount) {
+  if (!(h = hash_find (pop_data->uid_hash, line))) {
     debug_print (1, ("new header %d %s\n", index, line));
 
+    i = ctx->msgcount;
     if (i >= ctx->hdrmax)
       mx_alloc_memory (ctx);
 
     ctx->msgcount++;
-    ctx->hdrs[i] = mutt_new_header ();
-    ctx->hdrs[i]->data = str_dup (line);
+    h = ctx->hdrs[i] = mutt_new_header ();
+    h->data = str_dup (line);
+
+    if (pop_data->uid_hash->nelem < pop_data->uid_hash->curnelem * 2)
+      pop_data->uid_hash = hash_resize (pop_data->uid_hash,
+                                        pop_data->uid_hash->nelem * 2);
+    hash_insert (pop_data->uid_hash, h->data, h, 0);
   }
-  else if (ctx->hdrs[i]->index != index - 1)
+  else if (h->index != index - 1)
     pop_data->clear_cache = 1;
 
-  ctx->hdrs[i]->refno = index;
-  ctx->hdrs[i]->index = index - 1;
+  h->refno = index;
+  h->index = index - 1;
 
   return 0;
 }
 
+#if USE_HCACHE
+static size_t pop_hcache_keylen (const char *fn)
+{
+  return str_len (fn);
+}
+#endif /* USE_HCACHE */
+
 /*
  * Read headers
  * returns:
@@ -162,20 +209,26 @@ static int fetch_uidl (char *line, void *data)
  */
 static int pop_fetch_headers (CONTEXT * ctx)
 {
-  int i, old_count, new_count;
+  int i, old_count, new_count, sent = 0, pipelined;
   pop_query_status ret;
   POP_DATA *pop_data = (POP_DATA *) ctx->data;
+  char tempfile[_POSIX_PATH_MAX];
+  FILE *f = NULL;
+#if USE_HCACHE
+  void *hc = NULL;
+  void *data;
+  HEADER *h;
+#endif
 
   time (&pop_data->check_time);
   pop_data->clear_cache = 0;
 
-  for (i = 0; i < ctx->msgcount; i++)
-    ctx->hdrs[i]->refno = -1;
-
+  pop_uid_hash_create (ctx);
   old_count = ctx->msgcount;
   ret = pop_fetch_data (pop_data, "UIDL\r\n", NULL, fetch_uidl, ctx);
   new_count = ctx->msgcount;
   ctx->msgcount = old_count;
+  pop_uid_hash_destroy (pop_data);
 
   if (pop_data->cmd_uidl == CMD_UNKNOWN) {
     if (ret == PQ_OK) {
@@ -193,18 +246,65 @@ static int pop_fetch_headers (CONTEXT * ctx)
     }
   }
 
+  if (ret == PQ_OK && new_count > old_count) {
+    mutt_mktemp (tempfile);
+    if (!(f = safe_fopen (tempfile, "w+"))) {
+      mutt_perror (tempfile);
+      ret = PFD_FUNCT_ERROR;
+    }
+  }
+
   if (ret == PQ_OK) {
     for (i = 0; i < old_count; i++)
       if (ctx->hdrs[i]->refno == -1)
         ctx->hdrs[i]->deleted = 1;
 
+#if USE_HCACHE
+    /* headers found in the cache need not be downloaded at all */
+    if (new_count > old_count && (hc = mutt_hcache_open (HeaderCache, ctx->path))) {
+      for (i = old_count; i < new_count; i++) {
+        h = ctx->hdrs[i];
+        if (!(data = mutt_hcache_fetch (hc, h->data, &pop_hcache_keylen)))
+          continue;
+        ctx->hdrs[i] = mutt_hcache_restore ((unsigned char *) data, NULL, 0);
+        ctx->hdrs[i]->data = h->data;
+        ctx->hdrs[i]->refno = h->refno;
+        ctx->hdrs[i]->index = h->index;
+        h->data = NULL;
+        mutt_free_header (&h);
+        mem_free (&data);
+      }
+    }
+#endif /* USE_HCACHE */
+
+    /* send commands ahead only once TOP is known to work */
+    pipelined = pop_data->pipelining && pop_data->cmd_top == CMD_AVAILABLE;
+
     for (i = old_count; i < new_count; i++) {
       mutt_message (_("Fetching message headers... [%d/%d]"),
                     i + 1 - old_count, new_count - old_count);
 
-      ret = pop_read_header (pop_data, ctx->hdrs[i]);
-      if (ret != PQ_OK)
-        break;
+      if (!ctx->hdrs[i]->env) {
+        if (pipelined && i >= sent &&
+            (sent = pop_send_header_cmds (ctx, i, new_count)) < 0) {
+          ret = PQ_NOT_CONNECTED;
+          break;
+        }
+
+        ret = pop_read_header (pop_data, ctx->hdrs[i], f, pipelined);
+        if (ret != PQ_OK) {
+          /* rather reconnect than skip the answers still in transit */
+          if (pipelined)
+            pop_data->status = POP_DISCONNECTED;
+          break;
+        }
+
+#if USE_HCACHE
+        if (hc)
+          mutt_hcache_store (hc, ctx->hdrs[i]->data, ctx->hdrs[i], 0,
+                             &pop_hcache_keylen);
+#endif /* USE_HCACHE */
+      }
 
       ctx->msgcount++;
     }
@@ -213,6 +313,16 @@ static int pop_fetch_headers (CONTEXT * ctx)
       mx_update_context (ctx, i - old_count);
   }
 
+#if USE_HCACHE
+  if (hc)
+    mutt_hcache_close (hc);
+#endif /* USE_HCACHE */
+
+  if (f) {
+    fclose (f);
+    unlink (tempfile);
+  }
+
   if (ret != PQ_OK) {
     for (i = ctx->msgcount; i < new_count; i++)
       mutt_free_header (&ctx->hdrs[i]);
@@ -436,6 +546,9 @@ pop_query_status pop_sync_mailbox (CONTEXT * ctx, int unused, int *index_hint)
   pop_query_status ret;
   char buf[LONG_STRING];
   POP_DATA *pop_data = (POP_DATA *) ctx->data;
+#if USE_HCACHE
+  void *hc;
+#endif
 
   pop_data->check_time = 0;
 
@@ -445,13 +558,26 @@ pop_query_status pop_sync_mailbox (CONTEXT * ctx, int unused, int *index_hint)
 
     mutt_message (_("Marking %d messages deleted..."), ctx->deleted);
 
+#if USE_HCACHE
+    hc = mutt_hcache_open (HeaderCache, ctx->path);
+#endif
+
     for (i = 0, ret = 0; ret == 0 && i < ctx->msgcount; i++) {
       if (ctx->hdrs[i]->deleted) {
         snprintf (buf, sizeof (buf), "DELE %d\r\n", ctx->hdrs[i]->refno);
         ret = pop_query (pop_data, buf, sizeof (buf));
+#if USE_HCACHE
+        if (ret == PQ_OK && hc)
+          mutt_hcache_delete (hc, ctx->hdrs[i]->data, &pop_hcache_keylen);
+#endif
       }
     }
 
+#if USE_HCACHE
+    if (hc)
+      mutt_hcache_close (hc);
+#endif
+
     if (ret == PQ_OK) {
       strfcpy (buf, "QUIT\r\n", sizeof (buf));
       ret = pop_query (pop_data, buf, sizeof (buf));
@@ -20,6 +20,9 @@
 /* number of entries in the hash table */
 #define POP_CACHE_LEN 10
 
+/* number of LIST/TOP pairs sent ahead when the server does PIPELINING */
+#define POP_PIPELINE_DEPTH 32
+
 /* maximal length of the server response (RFC1939) */
 #define POP_CMD_RESPONSE 512
 
@@ -67,6 +70,7 @@ typedef struct {
   cmd_status cmd_uidl;      /* optional command UIDL */
   cmd_status cmd_top;       /* optional command TOP */
   unsigned int resp_codes:1;    /* server supports extended response codes */
+  unsigned int pipelining:1;    /* server supports PIPELINING (RFC2449) */
   unsigned int expire:1;        /* expire is greater than 0 */
   unsigned int clear_cache:1;
   size_t size;
@@ -76,6 +80,7 @@ typedef struct {
   char *timestamp;
   char err_msg[POP_CMD_RESPONSE];
   POP_CACHE cache[POP_CACHE_LEN];
+  HASH *uid_hash;               /* UIDL -> HEADER, only while parsing UIDL */
 } POP_DATA;
 
 typedef struct {
@@ -96,8 +101,13 @@ int pop_parse_path (const char *, ACCOUNT *);
 int pop_connect (POP_DATA *);
 pop_query_status pop_open_connection (POP_DATA *);
 pop_query_status pop_query_d (POP_DATA *, char *, size_t, char *);
+pop_query_status pop_read_response (POP_DATA *, const char *, char *, size_t);
 pop_query_status pop_fetch_data (POP_DATA *, char *, progress_t*, int (*funct) (char *, void *),
                     void *);
+pop_query_status pop_read_data (POP_DATA *, progress_t*, int (*funct) (char *, void *),
+                    void *);
+void pop_uid_hash_create (CONTEXT *);
+void pop_uid_hash_destroy (POP_DATA *);
 pop_query_status pop_reconnect (CONTEXT *);
 void pop_logout (CONTEXT *);
 void pop_error (POP_DATA *, char *);
@@ -103,6 +103,9 @@ static int fetch_capa (char *line, void *data)
   else if (!ascii_strncasecmp (line, "TOP", 3))
     pop_data->cmd_top = CMD_AVAILABLE;
 
+  else if (!ascii_strncasecmp (line, "PIPELINING", 10))
+    pop_data->pipelining = 1;
+
   return 0;
 }
 
@@ -147,6 +150,7 @@ static pop_query_status pop_capabilities (POP_DATA * pop_data, int mode)
     pop_data->cmd_uidl = CMD_NOT_AVAILABLE;
     pop_data->cmd_top = CMD_NOT_AVAILABLE;
     pop_data->resp_codes = 0;
+    pop_data->pipelining = 0;
     pop_data->expire = 1;
     pop_data->login_delay = 0;
     mem_free (&pop_data->auth_list);
@@ -406,7 +410,20 @@ pop_query_status pop_query_d (POP_DATA * pop_data, char *buf, size_t buflen, cha
 
   c = strpbrk (buf, " \r\n");
   *c = '\0';
-  snprintf (pop_data->err_msg, sizeof (pop_data->err_msg), "%s: ", buf);
+
+  return pop_read_response (pop_data, buf, buf, buflen);
+}
+
+/*
+ * Receive the answer to an already sent command cmd into buf
+ *  0 - successful,
+ * -1 - conection lost,
+ * -2 - invalid command or execution error.
+*/
+pop_query_status pop_read_response (POP_DATA * pop_data, const char *cmd,
+                                    char *buf, size_t buflen)
+{
+  snprintf (pop_data->err_msg, sizeof (pop_data->err_msg), "%s: ", cmd);
 
   if (mutt_socket_readln (buf, buflen, pop_data->conn) < 0) {
     pop_data->status = POP_DISCONNECTED;
@@ -432,18 +449,31 @@ pop_query_status pop_fetch_data (POP_DATA * pop_data, char *query, progress_t* b
                     int (*funct) (char *, void *), void *data)
 {
   char buf[LONG_STRING];
-  char *inbuf;
-  char *p;
   pop_query_status ret;
-  int chunk = 0;
-  long pos = 0;
-  size_t lenbuf = 0;
 
   strfcpy (buf, query, sizeof (buf));
   ret = pop_query (pop_data, buf, sizeof (buf));
   if (ret != PQ_OK)
     return ret;
 
+  return pop_read_data (pop_data, bar, funct, data);
+}
+
+/*
+ * Like pop_fetch_data() but for a command whose positive answer has
+ * already been read, e.g. when pipelining.
+ */
+pop_query_status pop_read_data (POP_DATA * pop_data, progress_t* bar,
+                                int (*funct) (char *, void *), void *data)
+{
+  char buf[LONG_STRING];
+  char *inbuf;
+  char *p;
+  pop_query_status ret = PQ_OK;
+  int chunk = 0;
+  long pos = 0;
+  size_t lenbuf = 0;
+
   inbuf = mem_malloc (sizeof (buf));
 
   FOREVER {
@@ -487,19 +517,37 @@ pop_query_status pop_fetch_data (POP_DATA * pop_data, char *query, progress_t* b
 /* find message with this UIDL and set refno */
 static int check_uidl (char *line, void *data)
 {
-  int i;
   unsigned int index;
   CONTEXT *ctx = (CONTEXT *) data;
+  POP_DATA *pop_data = (POP_DATA *) ctx->data;
+  HEADER *h;
 
   sscanf (line, "%u %s", &index, line);
+  if ((h = hash_find (pop_data->uid_hash, line)))
+    h->refno = index;
+
+  return 0;
+}
+
+/*
+ * Hash all messages of ctx by UIDL for the UIDL parsers and mark them
+ * as not (yet) seen on the server.
+ */
+void pop_uid_hash_create (CONTEXT * ctx)
+{
+  int i;
+  POP_DATA *pop_data = (POP_DATA *) ctx->data;
+
+  pop_data->uid_hash = hash_create (ctx->msgcount * 2 + 64);
   for (i = 0; i < ctx->msgcount; i++) {
-    if (!str_cmp (ctx->hdrs[i]->data, line)) {
-      ctx->hdrs[i]->refno = index;
-      break;
-    }
+    ctx->hdrs[i]->refno = -1;
+    hash_insert (pop_data->uid_hash, ctx->hdrs[i]->data, ctx->hdrs[i], 0);
   }
+}
 
-  return 0;
+void pop_uid_hash_destroy (POP_DATA * pop_data)
+{
+  hash_destroy (&pop_data->uid_hash, NULL);
 }
 
 /* reconnect and verify indexes if connection was lost */
@@ -519,16 +567,13 @@ pop_query_status pop_reconnect (CONTEXT * ctx)
 
     ret = pop_open_connection (pop_data);
     if (ret == PQ_OK) {
-      int i;
-
       bar.msg = _("Verifying message indexes...");
       bar.size = 0;
       mutt_progress_bar (&bar, 0);
 
-      for (i = 0; i < ctx->msgcount; i++)
-        ctx->hdrs[i]->refno = -1;
-
+      pop_uid_hash_create (ctx);
       ret = pop_fetch_data (pop_data, "UIDL\r\n", &bar, check_uidl, ctx);
+      pop_uid_hash_destroy (pop_data);
       if (ret == PQ_ERR) {
         mutt_error ("%s", pop_data->err_msg);
         mutt_sleep (2);
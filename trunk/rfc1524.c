@@ -153,13 +153,12 @@ static int get_field_text (char *field, char **entry,
   }
 }
 
-static int rfc1524_mailcap_parse (BODY * a,
-                                  char *filename,
-                                  char *type, rfc1524_entry * entry, int opt)
+/* checks one (already continued) mailcap line against type; the
+ * line is clobbered */
+static int rfc1524_mailcap_entry (BODY * a, char *buf, char *filename,
+                                  int line, char *type, int btlen,
+                                  rfc1524_entry * entry, int opt)
 {
-  FILE *fp;
-  char *buf = NULL;
-  size_t buflen;
   char *ch;
   char *field;
   int found = FALSE;
@@ -167,9 +166,265 @@ static int rfc1524_mailcap_parse (BODY * a,
   int composecommand;
   int editcommand;
   int printcommand;
-  int btlen;
+
+  debug_print (2, ("mailcap entry: %s\n", buf));
+
+  /* check type */
+  ch = get_field (buf);
+  if (ascii_strcasecmp (buf, type) && (ascii_strncasecmp (buf, type, btlen) || (buf[btlen] != 0 &&      /* implicit wild */
+                                                                                str_cmp (buf + btlen, "/*"))))  /* wildsubtype */
+    return FALSE;
+
+  /* next field is the viewcommand */
+  field = ch;
+  ch = get_field (ch);
+  if (entry)
+    entry->command = str_dup (field);
+
+  /* parse the optional fields */
+  found = TRUE;
+  copiousoutput = FALSE;
+  composecommand = FALSE;
+  editcommand = FALSE;
+  printcommand = FALSE;
+
+  while (ch) {
+    field = ch;
+    ch = get_field (ch);
+    debug_print (2, ("field: %s\n", field));
+
+    if (!ascii_strcasecmp (field, "needsterminal")) {
+      if (entry)
+        entry->needsterminal = TRUE;
+    }
+    else if (!ascii_strcasecmp (field, "copiousoutput")) {
+      copiousoutput = TRUE;
+      if (entry)
+        entry->copiousoutput = TRUE;
+    }
+    else if (!ascii_strncasecmp (field, "composetyped", 12)) {
+      /* this compare most occur before compose to match correctly */
+      if (get_field_text
+          (field + 12, entry ? &entry->composetypecommand : NULL, type,
+           filename, line))
+        composecommand = TRUE;
+    }
+    else if (!ascii_strncasecmp (field, "compose", 7)) {
+      if (get_field_text
+          (field + 7, entry ? &entry->composecommand : NULL, type,
+           filename, line))
+        composecommand = TRUE;
+    }
+    else if (!ascii_strncasecmp (field, "print", 5)) {
+      if (get_field_text (field + 5, entry ? &entry->printcommand : NULL,
+                          type, filename, line))
+        printcommand = TRUE;
+    }
+    else if (!ascii_strncasecmp (field, "edit", 4)) {
+      if (get_field_text (field + 4, entry ? &entry->editcommand : NULL,
+                          type, filename, line))
+        editcommand = TRUE;
+    }
+    else if (!ascii_strncasecmp (field, "nametemplate", 12)) {
+      get_field_text (field + 12, entry ? &entry->nametemplate : NULL,
+                      type, filename, line);
+    }
+    else if (!ascii_strncasecmp (field, "x-convert", 9)) {
+      get_field_text (field + 9, entry ? &entry->convert : NULL,
+                      type, filename, line);
+    }
+    else if (!ascii_strncasecmp (field, "test", 4)) {
+      /* 
+       * This routine executes the given test command to determine
+       * if this is the right entry.
+       */
+      char *test_command = NULL;
+      size_t len;
+
+      if (get_field_text (field + 4, &test_command, type, filename, line)
+          && test_command) {
+        len = str_len (test_command) + STRING;
+        mem_realloc (&test_command, len);
+        rfc1524_expand_command (a, a->filename, type, test_command, len);
+        if (mutt_system (test_command)) {
+          /* a non-zero exit code means test failed */
+          found = FALSE;
+        }
+        mem_free (&test_command);
+      }
+    }
+  }                             /* while (ch) */
+
+  if (opt == M_AUTOVIEW) {
+    if (!copiousoutput)
+      found = FALSE;
+  }
+  else if (opt == M_COMPOSE) {
+    if (!composecommand)
+      found = FALSE;
+  }
+  else if (opt == M_EDIT) {
+    if (!editcommand)
+      found = FALSE;
+  }
+  else if (opt == M_PRINT) {
+    if (!printcommand)
+      found = FALSE;
+  }
+
+  if (!found) {
+    /* reset */
+    if (entry) {
+      mem_free (&entry->command);
+      mem_free (&entry->composecommand);
+      mem_free (&entry->composetypecommand);
+      mem_free (&entry->editcommand);
+      mem_free (&entry->printcommand);
+      mem_free (&entry->nametemplate);
+      mem_free (&entry->convert);
+      entry->needsterminal = 0;
+      entry->copiousoutput = 0;
+    }
+  }
+
+  return found;
+}
+
+/*
+ * Mailcap files are read once and kept as their (continued) lines,
+ * chained by lowercase base type, until they change on disk. A
+ * lookup then only looks at the lines for its base type.
+ */
+
+typedef struct mailcap_line {
+  char *text;
+  char *base;                   /* lowercase base type */
+  int line;                     /* line number, for error messages */
+  struct mailcap_line *next;    /* next one for the same base type */
+} mailcap_line_t;
+
+typedef struct mailcap_file {
+  char *path;
+  time_t mtime;
+  off_t size;
+  ino_t ino;
+  mailcap_line_t **lines;       /* in file order */
+  int count;
+  int max;
+  HASH *types;                  /* lowercase base type -> first line */
+  struct mailcap_file *next;
+} mailcap_file_t;
+
+static mailcap_file_t *MailcapFiles = NULL;
+
+static void mailcap_file_free (mailcap_file_t * mc)
+{
+  int i;
+
+  if (mc->types)
+    hash_destroy (&mc->types, NULL);
+  for (i = 0; i < mc->count; i++) {
+    mem_free (&mc->lines[i]->text);
+    mem_free (&mc->lines[i]->base);
+    mem_free (&mc->lines[i]);
+  }
+  mem_free (&mc->lines);
+  mc->count = mc->max = 0;
+}
+
+/* returns the (re)loaded mailcap file, NULL if there is none */
+static mailcap_file_t *mailcap_file_get (char *filename)
+{
+  mailcap_file_t *mc;
+  mailcap_line_t *l, *p;
+  FILE *fp;
+  char *buf = NULL;
+  char *ch;
+  size_t buflen;
+  struct stat st;
   int line = 0;
 
+  for (mc = MailcapFiles; mc; mc = mc->next)
+    if (!str_cmp (mc->path, filename))
+      break;
+
+  if (stat (filename, &st) == -1) {
+    if (mc)
+      mailcap_file_free (mc);
+    return NULL;
+  }
+
+  if (!mc) {
+    mc = mem_calloc (1, sizeof (mailcap_file_t));
+    mc->path = str_dup (filename);
+    mc->next = MailcapFiles;
+    MailcapFiles = mc;
+  }
+  else if (mc->types && mc->mtime == st.st_mtime &&
+           mc->size == st.st_size && mc->ino == st.st_ino)
+    return mc;
+
+  mailcap_file_free (mc);
+
+  if ((fp = fopen (filename, "r")) == NULL)
+    return NULL;
+
+  debug_print (2, ("loading %s\n", filename));
+  mc->mtime = st.st_mtime;
+  mc->size = st.st_size;
+  mc->ino = st.st_ino;
+  mc->types = hash_create (64);
+
+  while ((buf = mutt_read_line (buf, &buflen, fp, &line)) != NULL) {
+    /* ignore comments */
+    if (*buf == '#')
+      continue;
+
+    l = mem_calloc (1, sizeof (mailcap_line_t));
+    l->text = str_dup (buf);
+    l->line = line;
+
+    if (mc->count == mc->max) {
+      mc->max += 64;
+      mem_realloc (&mc->lines, mc->max * sizeof (mailcap_line_t *));
+    }
+    mc->lines[mc->count++] = l;
+
+    /* the base type is the part of the type field before any '/' */
+    get_field (buf);
+    if ((ch = strchr (buf, '/')))
+      *ch = '\0';
+    for (ch = buf; *ch; ch++)
+      *ch = ascii_tolower (*ch);
+    l->base = str_dup (buf);
+
+    if ((p = hash_find (mc->types, l->base))) {
+      while (p->next)
+        p = p->next;
+      p->next = l;
+    }
+    else
+      hash_insert (mc->types, l->base, l, 0);
+  }
+
+  fclose (fp);
+  mem_free (&buf);
+  return mc;
+}
+
+static int rfc1524_mailcap_parse (BODY * a,
+                                  char *filename,
+                                  char *type, rfc1524_entry * entry, int opt)
+{
+  mailcap_file_t *mc;
+  mailcap_line_t *l;
+  char base[SHORT_STRING];
+  char *buf;
+  char *ch;
+  int found = FALSE;
+  int btlen;
+  int i;
+
   /* rfc1524 mailcap file is of the format:
    * base/type; command; extradefs
    * type can be * for matching all
@@ -186,134 +441,20 @@ static int rfc1524_mailcap_parse (BODY * a,
     return FALSE;
   btlen = ch - type;
 
-  if ((fp = fopen (filename, "r")) != NULL) {
-    while (!found && (buf = mutt_read_line (buf, &buflen, fp, &line)) != NULL) {
-      /* ignore comments */
-      if (*buf == '#')
-        continue;
-      debug_print (2, ("mailcap entry: %s\n", buf));
-
-      /* check type */
-      ch = get_field (buf);
-      if (ascii_strcasecmp (buf, type) && (ascii_strncasecmp (buf, type, btlen) || (buf[btlen] != 0 &&  /* implicit wild */
-                                                                                    str_cmp (buf + btlen, "/*"))))  /* wildsubtype */
-        continue;
-
-      /* next field is the viewcommand */
-      field = ch;
-      ch = get_field (ch);
-      if (entry)
-        entry->command = str_dup (field);
-
-      /* parse the optional fields */
-      found = TRUE;
-      copiousoutput = FALSE;
-      composecommand = FALSE;
-      editcommand = FALSE;
-      printcommand = FALSE;
-
-      while (ch) {
-        field = ch;
-        ch = get_field (ch);
-        debug_print (2, ("field: %s\n", field));
-
-        if (!ascii_strcasecmp (field, "needsterminal")) {
-          if (entry)
-            entry->needsterminal = TRUE;
-        }
-        else if (!ascii_strcasecmp (field, "copiousoutput")) {
-          copiousoutput = TRUE;
-          if (entry)
-            entry->copiousoutput = TRUE;
-        }
-        else if (!ascii_strncasecmp (field, "composetyped", 12)) {
-          /* this compare most occur before compose to match correctly */
-          if (get_field_text
-              (field + 12, entry ? &entry->composetypecommand : NULL, type,
-               filename, line))
-            composecommand = TRUE;
-        }
-        else if (!ascii_strncasecmp (field, "compose", 7)) {
-          if (get_field_text
-              (field + 7, entry ? &entry->composecommand : NULL, type,
-               filename, line))
-            composecommand = TRUE;
-        }
-        else if (!ascii_strncasecmp (field, "print", 5)) {
-          if (get_field_text (field + 5, entry ? &entry->printcommand : NULL,
-                              type, filename, line))
-            printcommand = TRUE;
-        }
-        else if (!ascii_strncasecmp (field, "edit", 4)) {
-          if (get_field_text (field + 4, entry ? &entry->editcommand : NULL,
-                              type, filename, line))
-            editcommand = TRUE;
-        }
-        else if (!ascii_strncasecmp (field, "nametemplate", 12)) {
-          get_field_text (field + 12, entry ? &entry->nametemplate : NULL,
-                          type, filename, line);
-        }
-        else if (!ascii_strncasecmp (field, "x-convert", 9)) {
-          get_field_text (field + 9, entry ? &entry->convert : NULL,
-                          type, filename, line);
-        }
-        else if (!ascii_strncasecmp (field, "test", 4)) {
-          /* 
-           * This routine executes the given test command to determine
-           * if this is the right entry.
-           */
-          char *test_command = NULL;
-          size_t len;
-
-          if (get_field_text (field + 4, &test_command, type, filename, line)
-              && test_command) {
-            len = str_len (test_command) + STRING;
-            mem_realloc (&test_command, len);
-            rfc1524_expand_command (a, a->filename, type, test_command, len);
-            if (mutt_system (test_command)) {
-              /* a non-zero exit code means test failed */
-              found = FALSE;
-            }
-            mem_free (&test_command);
-          }
-        }
-      }                         /* while (ch) */
+  if ((mc = mailcap_file_get (filename)) == NULL)
+    return FALSE;
 
-      if (opt == M_AUTOVIEW) {
-        if (!copiousoutput)
-          found = FALSE;
-      }
-      else if (opt == M_COMPOSE) {
-        if (!composecommand)
-          found = FALSE;
-      }
-      else if (opt == M_EDIT) {
-        if (!editcommand)
-          found = FALSE;
-      }
-      else if (opt == M_PRINT) {
-        if (!printcommand)
-          found = FALSE;
-      }
+  for (i = 0; i < btlen && i < sizeof (base) - 1; i++)
+    base[i] = ascii_tolower (type[i]);
+  base[i] = '\0';
+
+  for (l = hash_find (mc->types, base); !found && l; l = l->next) {
+    buf = str_dup (l->text);
+    found = rfc1524_mailcap_entry (a, buf, filename, l->line, type, btlen,
+                                   entry, opt);
+    mem_free (&buf);
+  }
 
-      if (!found) {
-        /* reset */
-        if (entry) {
-          mem_free (&entry->command);
-          mem_free (&entry->composecommand);
-          mem_free (&entry->composetypecommand);
-          mem_free (&entry->editcommand);
-          mem_free (&entry->printcommand);
-          mem_free (&entry->nametemplate);
-          mem_free (&entry->convert);
-          entry->needsterminal = 0;
-          entry->copiousoutput = 0;
-        }
-      }
-    }                           /* while (!found && (buf = mutt_read_line ())) */
-    fclose (fp);
-  }                             /* if ((fp = fopen ())) */
-  mem_free (&buf);
   return found;
 }
 
@@ -67,7 +67,7 @@ static size_t convert_string (ICONV_CONST char *f, size_t flen,
   if (n == (size_t) (-1) || iconv (cd, 0, 0, &ob, &obl) == (size_t) (-1)) {
     e = errno;
     mem_free (&buf);
-    iconv_close (cd);
+    mutt_iconv_close (cd);
     errno = e;
     return (size_t) (-1);
   }
@@ -77,7 +77,7 @@ static size_t convert_string (ICONV_CONST char *f, size_t flen,
 
   mem_realloc (&buf, ob - buf + 1);
   *t = buf;
-  iconv_close (cd);
+  mutt_iconv_close (cd);
 
   return n;
 }
@@ -233,11 +233,11 @@ static size_t try_block (ICONV_CONST char *d, size_t dlen,
     if (iconv (cd, &ib, &ibl, &ob, &obl) == (size_t) (-1) ||
         iconv (cd, 0, 0, &ob, &obl) == (size_t) (-1)) {
       assert (errno == E2BIG);
-      iconv_close (cd);
+      mutt_iconv_close (cd);
       assert (ib > d);
       return (ib - d == dlen) ? dlen : ib - d + 1;
     }
-    iconv_close (cd);
+    mutt_iconv_close (cd);
   }
   else {
     if (dlen > sizeof (buf1) - str_len (tocode))
@@ -299,7 +299,7 @@ static size_t encode_block (char *s, char *d, size_t dlen,
     n1 = iconv (cd, &ib, &ibl, &ob, &obl);
     n2 = iconv (cd, 0, 0, &ob, &obl);
     assert (n1 != (size_t) (-1) && n2 != (size_t) (-1));
-    iconv_close (cd);
+    mutt_iconv_close (cd);
     return (*encoder) (s, buf1, ob - buf1, tocode);
   }
   else
@@ -17,6 +17,7 @@
 
 #include "lib/mem.h"
 #include "lib/intl.h"
+#include "lib/str.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -26,11 +27,118 @@ typedef struct score_t {
   pattern_t *pat;
   int val;
   int exact;                    /* if this rule matches, don't evaluate any more */
+  int id;                       /* result cache slot or -1 */
   struct score_t *next;
 } SCORE;
 
 SCORE *Score = NULL;
 
+/*
+ * The result of a rule only looking at what a message looked like when
+ * it was read can't change, so it is kept in the message's score_cache
+ * as two bits (known, matches) at the rule's id. Ids are kept per
+ * pattern across unscore/score so that sourcing an edited score file
+ * only evaluates the new rules; patterns with dates are compiled
+ * relative to now and always get a new id.
+ */
+typedef struct {
+  char *str;
+  int id;
+} SCORE_ID;
+
+static HASH *ScoreIds = NULL;
+static int ScoreNextId = 0;
+
+/* whether the result of pat for a message never changes and whether
+ * it depends on the time it was compiled */
+static int score_cacheable (pattern_t * pat, int *dated)
+{
+  for (; pat; pat = pat->next) {
+    switch (pat->op) {
+    case M_AND:
+    case M_OR:
+      if (!score_cacheable (pat->child, dated))
+        return 0;
+      break;
+    case M_DATE:
+    case M_DATE_RECEIVED:
+      *dated = 1;
+      break;
+    case M_ALL:
+    case M_SENDER:
+    case M_FROM:
+    case M_TO:
+    case M_CC:
+    case M_SUBJECT:
+    case M_ID:
+    case M_SIZE:
+    case M_ADDRESS:
+    case M_RECIPIENT:
+    case M_XLABEL:
+    case M_HORMEL:
+    case M_MULTIPART:
+#ifdef USE_NNTP
+    case M_NEWSGROUPS:
+#endif
+      break;
+    default:
+      /* flags, threads, scores, crypto status (hdr->security is
+       * recomputed whenever a message is displayed), and anything
+       * depending on the configuration such as lists or alternates */
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int score_id (const char *str, pattern_t * pat)
+{
+  SCORE_ID *sid;
+  int dated = 0;
+
+  if (!score_cacheable (pat, &dated))
+    return -1;
+
+  if (!ScoreIds)
+    ScoreIds = hash_create (64);
+  if (!(sid = hash_find (ScoreIds, str))) {
+    sid = mem_malloc (sizeof (SCORE_ID));
+    sid->str = str_dup (str);
+    if (ScoreIds->curnelem > 2 * ScoreIds->nelem)
+      ScoreIds = hash_resize (ScoreIds, 4 * ScoreIds->nelem);
+    hash_insert (ScoreIds, sid->str, sid, 0);
+  }
+  else if (!dated)
+    return sid->id;
+  sid->id = ScoreNextId++;
+  return sid->id;
+}
+
+static int score_match (SCORE * rule, HEADER * hdr)
+{
+  int r, shift;
+
+  if (rule->id < 0)
+    return mutt_pattern_exec (rule->pat, M_MATCH_FULL_ADDRESS, NULL, hdr) > 0;
+
+  shift = (rule->id % 4) * 2;
+  if (rule->id / 4 < hdr->score_cache_len &&
+      (hdr->score_cache[rule->id / 4] >> shift) & 1)
+    return (hdr->score_cache[rule->id / 4] >> (shift + 1)) & 1;
+
+  r = mutt_pattern_exec (rule->pat, M_MATCH_FULL_ADDRESS, NULL, hdr) > 0;
+  if (rule->id / 4 >= hdr->score_cache_len) {
+    int len = (ScoreNextId + 3) / 4;
+
+    mem_realloc (&hdr->score_cache, len);
+    memset (hdr->score_cache + hdr->score_cache_len, 0,
+            len - hdr->score_cache_len);
+    hdr->score_cache_len = len;
+  }
+  hdr->score_cache[rule->id / 4] |= (1 | (r << 1)) << shift;
+  return r;
+}
+
 void mutt_check_rescore (CONTEXT * ctx)
 {
   int i;
@@ -49,7 +157,7 @@ void mutt_check_rescore (CONTEXT * ctx)
 
     for (i = 0; ctx && i < ctx->msgcount; i++) {
       mutt_score_message (ctx, ctx->hdrs[i], 1);
-      ctx->hdrs[i]->pair = 0;
+      ctx->hdrs[i]->pair_gen = 0;
     }
   }
   unset_option (OPTNEEDRESCORE);
@@ -93,6 +201,7 @@ int mutt_parse_score (BUFFER * buf, BUFFER * s, unsigned long data,
       Score = ptr;
     ptr->pat = pat;
     ptr->str = pattern;
+    ptr->id = score_id (pattern, pat);
   }
   pc = buf->data;
   if (*pc == '=') {
@@ -110,7 +219,10 @@ void mutt_score_message (CONTEXT * ctx, HEADER * hdr, int upd_ctx)
 
   hdr->score = 0;               /* in case of re-scoring */
   for (tmp = Score; tmp; tmp = tmp->next) {
-    if (mutt_pattern_exec (tmp->pat, M_MATCH_FULL_ADDRESS, NULL, hdr) > 0) {
+    /* a rule adding nothing needs no evaluation */
+    if (!tmp->val && !tmp->exact)
+      continue;
+    if (score_match (tmp, hdr)) {
       if (tmp->exact || tmp->val == 9999 || tmp->val == -9999) {
         hdr->score = tmp->val;
         break;
@@ -85,12 +85,31 @@ static char MsgIdPfx = 'A';
 
 static void transform_to_7bit (BODY * a, FILE * fpin);
 
+/* number of input bytes the body encoders read at a time */
+#define ENC_BLOCK 3072
+
+/*
+ * Returns the next byte of the (converted) input, reading ENC_BLOCK
+ * sized chunks from fc into buf.
+ */
+static int enc_getc (FGETCONV * fc, char *buf, size_t * pos, size_t * len)
+{
+  if (*pos == *len) {
+    *pos = 0;
+    if (!(*len = fgetconvb (buf, ENC_BLOCK, fc)))
+      return EOF;
+  }
+  return (unsigned char) buf[(*pos)++];
+}
+
 static void encode_quoted (FGETCONV * fc, FILE * fout, int istext)
 {
   int c, linelen = 0;
   char line[77], savechar;
+  char bufi[ENC_BLOCK];
+  size_t n = 0, i = 0;
 
-  while ((c = fgetconv (fc)) != EOF) {
+  while ((c = enc_getc (fc, bufi, &i, &n)) != EOF) {
     /* Wrap the line if needed. */
     if (linelen == 76 && ((istext && c != '\n') || !istext)) {
       /* If the last character is "quoted", then be sure to move all three
@@ -202,82 +221,64 @@ static void encode_quoted (FGETCONV * fc, FILE * fout, int istext)
   }
 }
 
-static char b64_buffer[3];
-static short b64_num;
-static short b64_linelen;
-
-static void b64_flush (FILE * fout)
+static char *b64_quad (char *o, const unsigned char *in, int n, int *linelen)
 {
-  short i;
-
-  if (!b64_num)
-    return;
-
-  if (b64_linelen >= 72) {
-    fputc ('\n', fout);
-    b64_linelen = 0;
-  }
-
-  for (i = b64_num; i < 3; i++)
-    b64_buffer[i] = '\0';
-
-  fputc (B64Chars[(b64_buffer[0] >> 2) & 0x3f], fout);
-  b64_linelen++;
-  fputc (B64Chars
-         [((b64_buffer[0] & 0x3) << 4) | ((b64_buffer[1] >> 4) & 0xf)], fout);
-  b64_linelen++;
-
-  if (b64_num > 1) {
-    fputc (B64Chars
-           [((b64_buffer[1] & 0xf) << 2) | ((b64_buffer[2] >> 6) & 0x3)],
-           fout);
-    b64_linelen++;
-    if (b64_num > 2) {
-      fputc (B64Chars[b64_buffer[2] & 0x3f], fout);
-      b64_linelen++;
-    }
-  }
-
-  while (b64_linelen % 4) {
-    fputc ('=', fout);
-    b64_linelen++;
+  if (*linelen >= 72) {
+    *o++ = '\n';
+    *linelen = 0;
   }
 
-  b64_num = 0;
-}
-
-
-static void b64_putc (char c, FILE * fout)
-{
-  if (b64_num == 3)
-    b64_flush (fout);
+  *o++ = B64Chars[in[0] >> 2];
+  *o++ = B64Chars[((in[0] & 0x3) << 4) | (n > 1 ? in[1] >> 4 : 0)];
+  *o++ = n > 1 ? B64Chars[((in[1] & 0xf) << 2) | (n > 2 ? in[2] >> 6 : 0)]
+    : '=';
+  *o++ = n > 2 ? B64Chars[in[2] & 0x3f] : '=';
+  *linelen += 4;
 
-  b64_buffer[b64_num++] = c;
+  return o;
 }
 
-
 static void encode_base64 (FGETCONV * fc, FILE * fout, int istext)
 {
-  int ch, ch1 = EOF;
-
-  b64_num = b64_linelen = 0;
-
-  while ((ch = fgetconv (fc)) != EOF) {
-    if (istext && ch == '\n' && ch1 != '\r')
-      b64_putc ('\r', fout);
-    b64_putc (ch, fout);
-    ch1 = ch;
-  }
-  b64_flush (fout);
-  fputc ('\n', fout);
+  char bufi[ENC_BLOCK];
+  /* worst case every input byte is a bare LF getting a CR, plus the
+   * up to 2 bytes carried over from the previous block */
+  unsigned char in[2 * ENC_BLOCK + 2];
+  char out[(sizeof (in) / 3 + 1) * 5 + 1], *o;
+  size_t n, i, len = 0;
+  int ch1 = EOF, linelen = 0;
+
+  while ((n = fgetconvb (bufi, sizeof (bufi), fc)) > 0) {
+    for (i = 0; i < n; i++) {
+      if (istext && bufi[i] == '\n' && ch1 != '\r')
+        in[len++] = '\r';
+      in[len++] = bufi[i];
+      ch1 = bufi[i];
+    }
+
+    o = out;
+    for (i = 0; i + 3 <= len; i += 3)
+      o = b64_quad (o, in + i, 3, &linelen);
+    fwrite (out, 1, o - out, fout);
+
+    len -= i;
+    memmove (in, in + i, len);
+  }
+
+  o = out;
+  if (len)
+    o = b64_quad (o, in, len, &linelen);
+  *o++ = '\n';
+  fwrite (out, 1, o - out, fout);
 }
 
 static void encode_8bit (FGETCONV * fc, FILE * fout, int istext)
 {
-  int ch;
+  char buf[ENC_BLOCK];
+  size_t n;
 
-  while ((ch = fgetconv (fc)) != EOF)
-    fputc (ch, fout);
+  while ((n = fgetconvb (buf, sizeof (buf), fc)) > 0)
+    fwrite (buf, 1, n, fout);
 }
 
 
@@ -705,10 +706,9 @@ static size_t convert_file_to (FILE * file, const char *fromcode,
   }
 
   for (i = 0; i < ncodes; i++)
-    if (cd[i] != (iconv_t) (-1))
-      iconv_close (cd[i]);
+    mutt_iconv_close (cd[i]);
 
-  iconv_close (cd1);
+  mutt_iconv_close (cd1);
   mem_free (&cd);
   mem_free (&infos);
   mem_free (&score);
@@ -868,54 +868,107 @@ CONTENT *mutt_get_content_info (const char *fname, BODY * b)
   return info;
 }
 
-/* Given a file with path ``s'', see if there is a registered MIME type.
- * returns the major MIME type, and copies the subtype to ``d''.  First look
- * for ~/.mime.types, then look in a system mime.types if we can find one.
- * The longest match is used so that we can match `ps.gz' when `gz' also
- * exists.
+/*
+ * The mime.types files are parsed once into a table of file
+ * extensions, which is rebuilt when any of them changes on disk.
  */
 
-int mutt_lookup_mime_type (BODY * att, const char *path)
+typedef struct mime_type_ext {
+  char *ext;                    /* lowercase extension */
+  char *major;
+  char *minor;
+} mime_type_ext_t;
+
+static struct mime_types_file {
+  int exists;
+  time_t mtime;
+  off_t size;
+  ino_t ino;
+} MimeTypesFiles[4];
+
+static mime_type_ext_t **MimeTypeExts = NULL;   /* in file order */
+static int MimeTypeExtsCount = 0;
+static int MimeTypeExtsMax = 0;
+static HASH *MimeTypes = NULL;  /* extension -> first definition */
+
+static void mime_types_path (int count, char *buf, size_t buflen)
+{
+  /*
+   * can't use strtok() because we use it in an inner loop below, so use
+   * a switch statement here instead.
+   */
+  switch (count) {
+  case 0:
+    snprintf (buf, buflen, "%s/.mime.types", NONULL (Homedir));
+    break;
+  case 1:
+    strfcpy (buf, SYSCONFDIR "/muttng-mime.types", buflen);
+    break;
+  case 2:
+    strfcpy (buf, PKGDATADIR "/mime.types", buflen);
+    break;
+  case 3:
+    strfcpy (buf, SYSCONFDIR "/mime.types", buflen);
+    break;
+  }
+}
+
+static void mime_types_free (void)
+{
+  int i;
+
+  if (MimeTypes)
+    hash_destroy (&MimeTypes, NULL);
+  for (i = 0; i < MimeTypeExtsCount; i++) {
+    mem_free (&MimeTypeExts[i]->ext);
+    mem_free (&MimeTypeExts[i]->major);
+    mem_free (&MimeTypeExts[i]->minor);
+    mem_free (&MimeTypeExts[i]);
+  }
+  mem_free (&MimeTypeExts);
+  MimeTypeExtsCount = MimeTypeExtsMax = 0;
+}
+
+/* (re)loads the mime.types files if any of them changed */
+static void mime_types_load (void)
 {
   FILE *f;
   char *p, *q, *ct;
   char buf[LONG_STRING];
-  char subtype[STRING], xtype[STRING];
-  int count;
-  int szf, sze, cur_sze;
-  int type;
+  mime_type_ext_t *e;
+  struct stat st;
+  int count, changed = (MimeTypes == NULL);
 
-  *subtype = '\0';
-  *xtype = '\0';
-  type = TYPEOTHER;
-  cur_sze = 0;
+  for (count = 0; count < 4; count++) {
+    mime_types_path (count, buf, sizeof (buf));
+    if (stat (buf, &st) == -1) {
+      if (MimeTypesFiles[count].exists)
+        changed = 1;
+      MimeTypesFiles[count].exists = 0;
+      continue;
+    }
+    if (!MimeTypesFiles[count].exists ||
+        MimeTypesFiles[count].mtime != st.st_mtime ||
+        MimeTypesFiles[count].size != st.st_size ||
+        MimeTypesFiles[count].ino != st.st_ino)
+      changed = 1;
+    MimeTypesFiles[count].exists = 1;
+    MimeTypesFiles[count].mtime = st.st_mtime;
+    MimeTypesFiles[count].size = st.st_size;
+    MimeTypesFiles[count].ino = st.st_ino;
+  }
 
-  szf = str_len (path);
+  if (!changed)
+    return;
+
+  mime_types_free ();
+  MimeTypes = hash_create (1031);
 
   for (count = 0; count < 4; count++) {
-    /*
-     * can't use strtok() because we use it in an inner loop below, so use
-     * a switch statement here instead.
-     */
-    switch (count) {
-    case 0:
-      snprintf (buf, sizeof (buf), "%s/.mime.types", NONULL (Homedir));
-      break;
-    case 1:
-      strfcpy (buf, SYSCONFDIR "/muttng-mime.types", sizeof (buf));
-      break;
-    case 2:
-      strfcpy (buf, PKGDATADIR "/mime.types", sizeof (buf));
-      break;
-    case 3:
-      strfcpy (buf, SYSCONFDIR "/mime.types", sizeof (buf));
-      break;
-    default:
-      debug_print (1, ("Internal error, count = %d.\n", count));
-      goto bye;                 /* shouldn't happen */
-    }
+    mime_types_path (count, buf, sizeof (buf));
 
     if ((f = fopen (buf, "r")) != NULL) {
+      debug_print (2, ("loading %s\n", buf));
       while (fgets (buf, sizeof (buf) - 1, f) != NULL) {
         /* weed out any comments */
         if ((p = strchr (buf, '#')))
@@ -931,34 +984,28 @@ int mutt_lookup_mime_type (BODY * att, const char *path)
         *p++ = 0;
         SKIPWS (p);
 
+        /* split the content-type; skip malformed lines */
+        if ((q = strchr (ct, '/')) == NULL)
+          continue;
+        *q++ = 0;
+
         /* cycle through the file extensions */
         while ((p = strtok (p, " \t\n"))) {
-          sze = str_len (p);
-          if ((sze > cur_sze) && (szf >= sze) &&
-              (str_casecmp (path + szf - sze, p) == 0
-               || ascii_strcasecmp (path + szf - sze, p) == 0) && (szf == sze
-                                                                   || path[szf
-                                                                           -
-                                                                           sze
-                                                                           -
-                                                                           1]
-                                                                   == '.')) {
-            /* get the content-type */
-
-            if ((p = strchr (ct, '/')) == NULL) {
-              /* malformed line, just skip it. */
-              break;
+          str_tolower (p);
+          /* the first definition of an extension wins */
+          if (!hash_find (MimeTypes, p)) {
+            e = mem_malloc (sizeof (mime_type_ext_t));
+            e->ext = str_dup (p);
+            e->major = str_dup (ct);
+            e->minor = str_dup (q);
+
+            if (MimeTypeExtsCount == MimeTypeExtsMax) {
+              MimeTypeExtsMax += 256;
+              mem_realloc (&MimeTypeExts,
+                           MimeTypeExtsMax * sizeof (mime_type_ext_t *));
             }
-            *p++ = 0;
-
-            for (q = p; *q && !ISSPACE (*q); q++);
-
-            str_substrcpy (subtype, p, q, sizeof (subtype));
-
-            if ((type = mutt_check_mime_type (ct)) == TYPEOTHER)
-              strfcpy (xtype, ct, sizeof (xtype));
-
-            cur_sze = sze;
+            MimeTypeExts[MimeTypeExtsCount++] = e;
+            hash_insert (MimeTypes, e->ext, e, 0);
           }
           p = NULL;
         }
@@ -966,8 +1013,47 @@ int mutt_lookup_mime_type (BODY * att, const char *path)
       fclose (f);
     }
   }
+}
+
+/* Given a file with path ``s'', see if there is a registered MIME type.
+ * returns the major MIME type, and copies the subtype to ``d''.  First look
+ * for ~/.mime.types, then look in a system mime.types if we can find one.
+ * The longest match is used so that we can match `ps.gz' when `gz' also
+ * exists.
+ */
+
+int mutt_lookup_mime_type (BODY * att, const char *path)
+{
+  mime_type_ext_t *e = NULL;
+  char ext[STRING];
+  char subtype[STRING], xtype[STRING];
+  int szf, i;
+  int type;
+
+  *subtype = '\0';
+  *xtype = '\0';
+  type = TYPEOTHER;
+
+  mime_types_load ();
+
+  szf = str_len (path);
+
+  /* try the whole name and each suffix after a dot, longest first */
+  for (i = 0; !e && i < szf; i++) {
+    if (i > 0 && path[i - 1] != '.')
+      continue;
+    if (szf - i >= sizeof (ext))
+      continue;
+    strfcpy (ext, path + i, sizeof (ext));
+    str_tolower (ext);
+    e = hash_find (MimeTypes, ext);
+  }
 
-bye:
+  if (e) {
+    strfcpy (subtype, e->minor, sizeof (subtype));
+    if ((type = mutt_check_mime_type (e->major)) == TYPEOTHER)
+      strfcpy (xtype, e->major, sizeof (xtype));
+  }
 
   if (type != TYPEOTHER || *xtype != '\0') {
     att->type = type;
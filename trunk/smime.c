@@ -472,129 +472,228 @@ char *smime_ask_for_key (char *prompt, char *mailbox, short public)
 
 
 
+/*
+ * Parsed .index files of $smime_keys (0) and $smime_certificates (1).
+ * They're kept until the file changes so that resolving many
+ * recipients doesn't rescan the whole file for every single mailbox.
+ *
+ * index-file format:
+ *   mailbox certfile label issuer_certfile trust_flags\n
+ *
+ * certfile is a hash value generated by openssl.
+ * Note that this was done according to the OpenSSL
+ * specs on their CA-directory.
+ */
+
+typedef struct smime_index_entry {
+  char *fields[5];              /* missing fields are NULL */
+  int numFields;
+  struct smime_index_entry *next;       /* next one for the same mailbox */
+} smime_index_entry_t;
+
+static struct smime_index {
+  char *path;
+  time_t mtime;
+  off_t size;
+  ino_t ino;
+  smime_index_entry_t **entries;        /* in file order */
+  int count;
+  int max;
+  HASH *mailboxes;              /* lowercase mailbox -> first entry */
+} SmimeIndex[2];
+
+static void smime_index_free (struct smime_index *idx)
+{
+  int i, j;
+
+  if (idx->mailboxes)
+    hash_destroy (&idx->mailboxes, NULL);
+  for (i = 0; i < idx->count; i++) {
+    for (j = 0; j < 5; j++)
+      mem_free (&idx->entries[i]->fields[j]);
+    mem_free (&idx->entries[i]);
+  }
+  mem_free (&idx->entries);
+  idx->count = idx->max = 0;
+}
+
+/* returns the (re)loaded index, NULL if there is none */
+static struct smime_index *smime_index_get (short public)
+{
+  struct smime_index *idx = &SmimeIndex[public ? 1 : 0];
+  char path[_POSIX_PATH_MAX];
+  char buf[LONG_STRING];
+  char fields[5][STRING];
+  smime_index_entry_t *e, *p;
+  struct stat st;
+  FILE *fp;
+  int i, n;
+
+  snprintf (path, sizeof (path), "%s/.index",
+            (public ? NONULL (SmimeCertificates) : NONULL (SmimeKeys)));
+
+  if (stat (path, &st) == -1) {
+    smime_index_free (idx);
+    return NULL;
+  }
+
+  if (idx->mailboxes && !str_cmp (idx->path, path) &&
+      idx->mtime == st.st_mtime && idx->size == st.st_size &&
+      idx->ino == st.st_ino)
+    return idx;
+
+  smime_index_free (idx);
+
+  if ((fp = safe_fopen (path, "r")) == NULL) {
+    mutt_perror (path);
+    return NULL;
+  }
+
+  debug_print (2, ("loading %s\n", path));
+  str_replace (&idx->path, path);
+  idx->mtime = st.st_mtime;
+  idx->size = st.st_size;
+  idx->ino = st.st_ino;
+  idx->mailboxes = hash_create (st.st_size / 64 > 1031 ?
+                                st.st_size / 64 : 1031);
+
+  while (fgets (buf, sizeof (buf) - 1, fp) != NULL) {
+    n = sscanf (buf,
+                MUTT_FORMAT (STRING) " " MUTT_FORMAT (STRING) " "
+                MUTT_FORMAT (STRING) " " MUTT_FORMAT (STRING) " "
+                MUTT_FORMAT (STRING) "\n",
+                fields[0], fields[1], fields[2], fields[3], fields[4]);
+    if (n < 2)
+      continue;
+
+    e = mem_calloc (1, sizeof (smime_index_entry_t));
+    e->numFields = n;
+    for (i = 0; i < n; i++)
+      e->fields[i] = str_dup (fields[i]);
+    str_tolower (e->fields[0]);
+
+    if (idx->count == idx->max) {
+      idx->max += 64;
+      mem_realloc (&idx->entries, idx->max * sizeof (smime_index_entry_t *));
+    }
+    idx->entries[idx->count++] = e;
+
+    if ((p = hash_find (idx->mailboxes, e->fields[0]))) {
+      while (p->next)
+        p = p->next;
+      p->next = e;
+    }
+    else
+      hash_insert (idx->mailboxes, e->fields[0], e, 0);
+  }
+
+  safe_fclose (&fp);
+  return idx;
+}
+
 char *smime_get_field_from_db (char *mailbox, char *query, short public,
                                short may_ask)
 {
-  int addr_len, query_len, found = 0, ask = 0, choice = 0;
-  char cert_path[_POSIX_PATH_MAX];
+  int query_len, found = 0, ask = 0, choice = 0;
   char buf[LONG_STRING], prompt[STRING];
-  char fields[5][STRING];
   char key[STRING];
-  int numFields;
-  struct stat info;
   char key_trust_level = 0;
-  FILE *fp;
+  struct smime_index *idx;
+  smime_index_entry_t *e, *last = NULL;
+  const char *trust = "";
+  int i;
 
   if (!mailbox && !query)
     return (NULL);
 
-  addr_len = mailbox ? str_len (mailbox) : 0;
   query_len = query ? str_len (query) : 0;
 
   *key = '\0';
 
-  /* index-file format:
-     mailbox certfile label issuer_certfile trust_flags\n
-
-     certfile is a hash value generated by openssl.
-     Note that this was done according to the OpenSSL
-     specs on their CA-directory.
-
-   */
-  snprintf (cert_path, sizeof (cert_path), "%s/.index",
-            (public ? NONULL (SmimeCertificates) : NONULL (SmimeKeys)));
-
-  if (!stat (cert_path, &info)) {
-    if ((fp = safe_fopen (cert_path, "r")) == NULL) {
-      mutt_perror (cert_path);
-      return (NULL);
+  if ((idx = smime_index_get (public))) {
+    if (mailbox) {
+      strfcpy (buf, mailbox, sizeof (buf));
+      str_tolower (buf);
+      e = hash_find (idx->mailboxes, buf);
     }
+    else
+      e = NULL;
 
-    while (fgets (buf, sizeof (buf) - 1, fp) != NULL)
-      if (mailbox && !(str_ncasecmp (mailbox, buf, addr_len))) {
-        numFields = sscanf (buf,
-                            MUTT_FORMAT (STRING) " " MUTT_FORMAT (STRING) " "
-                            MUTT_FORMAT (STRING) " " MUTT_FORMAT (STRING) " "
-                            MUTT_FORMAT (STRING) "\n",
-                            fields[0], fields[1],
-                            fields[2], fields[3], fields[4]);
-        if (numFields < 2)
-          continue;
-        if (mailbox && public &&
-            (!fields[4] ||
-             *fields[4] == 'i' || *fields[4] == 'e' || *fields[4] == 'r'))
-          continue;
+    for (; e; e = e->next) {
+      last = e;
+      trust = NONULL (e->fields[4]);
+      if (public && (*trust == 'i' || *trust == 'e' || *trust == 'r'))
+        continue;
 
-        if (found) {
-          if (public && *fields[4] == 'u')
-            snprintf (prompt, sizeof (prompt),
-                      _
-                      ("ID %s is unverified. Do you want to use it for %s ?"),
-                      fields[1], mailbox);
-          else if (public && *fields[4] == 'v')
-            snprintf (prompt, sizeof (prompt),
-                      _("Use (untrusted!) ID %s for %s ?"),
-                      fields[1], mailbox);
-          else
-            snprintf (prompt, sizeof (prompt), _("Use ID %s for %s ?"),
-                      fields[1], mailbox);
-          if (may_ask == 0)
-            choice = M_YES;
-          if (may_ask && (choice = mutt_yesorno (prompt, M_NO)) == -1) {
-            found = 0;
-            ask = 0;
-            *key = '\0';
-            break;
-          }
-          else if (choice == M_NO) {
-            ask = 1;
-            continue;
-          }
-          else if (choice == M_YES) {
-            strfcpy (key, fields[1], sizeof (key));
-            ask = 0;
-            break;
-          }
-        }
-        else {
-          if (public)
-            key_trust_level = *fields[4];
-          strfcpy (key, fields[1], sizeof (key));
-        }
-        found = 1;
-      }
-      else if (query) {
-        numFields = sscanf (buf,
-                            MUTT_FORMAT (STRING) " " MUTT_FORMAT (STRING) " "
-                            MUTT_FORMAT (STRING) " " MUTT_FORMAT (STRING) " "
-                            MUTT_FORMAT (STRING) "\n",
-                            fields[0], fields[1],
-                            fields[2], fields[3], fields[4]);
-
-        /* query = label: return certificate. */
-        if (numFields >= 3 &&
-            !(str_ncasecmp (query, fields[2], query_len))) {
+      if (found) {
+        if (public && *trust == 'u')
+          snprintf (prompt, sizeof (prompt),
+                    _
+                    ("ID %s is unverified. Do you want to use it for %s ?"),
+                    e->fields[1], mailbox);
+        else if (public && *trust == 'v')
+          snprintf (prompt, sizeof (prompt),
+                    _("Use (untrusted!) ID %s for %s ?"),
+                    e->fields[1], mailbox);
+        else
+          snprintf (prompt, sizeof (prompt), _("Use ID %s for %s ?"),
+                    e->fields[1], mailbox);
+        if (may_ask == 0)
+          choice = M_YES;
+        if (may_ask && (choice = mutt_yesorno (prompt, M_NO)) == -1) {
+          found = 0;
           ask = 0;
-          strfcpy (key, fields[1], sizeof (key));
+          *key = '\0';
+          break;
+        }
+        else if (choice == M_NO) {
+          ask = 1;
+          continue;
         }
-        /* query = certificate: return intermediate certificate. */
-        else if (numFields >= 4 &&
-                 !(str_ncasecmp (query, fields[1], query_len))) {
+        else if (choice == M_YES) {
+          strfcpy (key, e->fields[1], sizeof (key));
           ask = 0;
-          strfcpy (key, fields[3], sizeof (key));
+          break;
         }
       }
+      else {
+        if (public)
+          key_trust_level = *trust;
+        strfcpy (key, e->fields[1], sizeof (key));
+      }
+      found = 1;
+    }
+
+    /* label and certificate queries match on prefixes, so they have
+     * to look at every entry; the last match wins */
+    for (i = 0; query && i < idx->count; i++) {
+      e = idx->entries[i];
+      if (mailbox && !str_casecmp (mailbox, e->fields[0]))
+        continue;
 
-    safe_fclose (&fp);
+      /* query = label: return certificate. */
+      if (e->numFields >= 3 &&
+          !(str_ncasecmp (query, e->fields[2], query_len))) {
+        ask = 0;
+        strfcpy (key, e->fields[1], sizeof (key));
+      }
+      /* query = certificate: return intermediate certificate. */
+      else if (e->numFields >= 4 &&
+               !(str_ncasecmp (query, e->fields[1], query_len))) {
+        ask = 0;
+        strfcpy (key, e->fields[3], sizeof (key));
+      }
+    }
 
     if (ask) {
-      if (public && *fields[4] == 'u')
+      if (public && *trust == 'u')
         snprintf (prompt, sizeof (prompt),
                   _("ID %s is unverified. Do you want to use it for %s ?"),
-                  fields[1], mailbox);
-      else if (public && *fields[4] == 'v')
+                  last->fields[1], mailbox);
+      else if (public && *trust == 'v')
         snprintf (prompt, sizeof (prompt),
-                  _("Use (untrusted!) ID %s for %s ?"), fields[1], mailbox);
+                  _("Use (untrusted!) ID %s for %s ?"), last->fields[1],
+                  mailbox);
       else
         snprintf (prompt, sizeof (prompt), _("Use ID %s for %s ?"), key,
                   mailbox);
@@ -1059,7 +1059,7 @@ int _mutt_traverse_thread (CONTEXT * ctx, HEADER * cur, int flag)
     num_hidden++;
 
   if (flag & (M_THREAD_COLLAPSE | M_THREAD_UNCOLLAPSE)) {
-    cur->pair = 0;              /* force index entry's color to be re-evaluated */
+    cur->pair_gen = 0;          /* force index entry's color to be re-evaluated */
     cur->collapsed = flag & M_THREAD_COLLAPSE;
     if (cur->virtual != -1) {
       roothdr = cur;
@@ -1085,7 +1085,7 @@ int _mutt_traverse_thread (CONTEXT * ctx, HEADER * cur, int flag)
 
     if (cur) {
       if (flag & (M_THREAD_COLLAPSE | M_THREAD_UNCOLLAPSE)) {
-        cur->pair = 0;          /* force index entry's color to be re-evaluated */
+        cur->pair_gen = 0;      /* force index entry's color to be re-evaluated */
         cur->collapsed = flag & M_THREAD_COLLAPSE;
         if (!roothdr && CHECK_LIMIT) {
           roothdr = cur;
@@ -1272,6 +1272,7 @@ void mutt_break_thread (HEADER * hdr)
   mutt_free_list (&hdr->env->in_reply_to);
   mutt_free_list (&hdr->env->references);
   hdr->env->irt_changed = hdr->env->refs_changed = hdr->changed = 1;
+  hdr->pair_gen = 0;
   clean_references (hdr->thread, hdr->thread->child);
 }
 